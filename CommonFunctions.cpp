@@ -18,6 +18,7 @@
  */
 
 #include "CommonFunctions.h"
+#include "Threading/Threading.h"
 
 #define GZIP_ENCODING				16
 
@@ -84,6 +85,12 @@ int CommonFunctions::compressGzip(int compressionLevel,
                                   ByteBuffer &rBuffOut,
                                   int zlibBufferSize)
 {
+    //large payload - use all cores
+    if(dataLen >= GZIP_PARALLEL_THRESHOLD)
+    {
+        return compressGzipParallel(compressionLevel, pData, dataLen, rBuffOut);
+    }
+    
     //buffer for zlib
     Bytef *pOutBuff = new Bytef[zlibBufferSize];
     
@@ -135,6 +142,188 @@ int CommonFunctions::compressGzip(int compressionLevel,
     return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
 }
 
+//shared state of parallel gzip
+struct GzipParallelJob
+{
+    const uint8             *m_pData;
+    size_t                  m_dataLen;
+    size_t                  m_blockSize;
+    size_t                  m_blockCount;
+    int                     m_compressionLevel;
+    std::atomic<size_t>     m_nextBlock;
+    std::atomic<int>        m_result;
+    std::vector<ByteBuffer> m_blocks;
+    std::vector<uLong>      m_crcs;
+    
+    //running ThreadPool workers
+    std::mutex              m_lock;
+    std::condition_variable m_cond;
+    uint32                  m_workers;
+};
+
+//compresses blocks until there is none left
+static void GzipParallel_compressBlocks(GzipParallelJob &rJob)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    
+    //raw deflate, header and trailer are written when blocks are joined
+    int ret = deflateInit2(&stream, rJob.m_compressionLevel, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if(ret != Z_OK)
+    {
+        rJob.m_result = ret;
+        return;
+    }
+    
+    size_t block;
+    while((block = rJob.m_nextBlock++) < rJob.m_blockCount && rJob.m_result == Z_OK)
+    {
+        size_t offset = block * rJob.m_blockSize;
+        size_t length = std::min(rJob.m_blockSize, rJob.m_dataLen - offset);
+        bool last = (block + 1 == rJob.m_blockCount);
+        
+        deflateReset(&stream);
+        
+        //previous data as dictionary - compression ratio stays close to single stream
+        if(offset != 0)
+        {
+            size_t dictLen = std::min<size_t>(offset, 32768);
+            deflateSetDictionary(&stream, rJob.m_pData + offset - dictLen, static_cast<uInt>(dictLen));
+        }
+        
+        //write directly to block buffer, sync flush ends block on byte boundary so blocks can be concatenated
+        ByteBuffer &rOut = rJob.m_blocks[block];
+        rOut.reserve(deflateBound(&stream, static_cast<uLong>(length)) + 64);
+        
+        stream.next_in = const_cast<Bytef*>(rJob.m_pData + offset);
+        stream.avail_in = static_cast<uInt>(length);
+        do
+        {
+            if(rOut.capacity() == rOut.size())
+            {
+                rOut.reserve(rOut.capacity() * 2);
+            }
+            stream.next_out = rOut.storage() + rOut.size();
+            stream.avail_out = static_cast<uInt>(rOut.capacity() - rOut.size());
+            ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+            rOut.resize(static_cast<size_t>(stream.next_out - rOut.storage()));
+        }while(stream.avail_out == 0 || (last && ret == Z_OK));
+        
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+        {
+            rJob.m_result = ret;
+        }
+        
+        rJob.m_crcs[block] = crc32(0L, rJob.m_pData + offset, static_cast<uInt>(length));
+    }
+    
+    deflateEnd(&stream);
+}
+
+class GzipParallelWorker : public ThreadContext
+{
+public:
+    explicit GzipParallelWorker(GzipParallelJob &rJob) : m_rJob(rJob)
+    {
+    }
+    
+    bool run()
+    {
+        CommonFunctions::SetThreadName("Gzip worker thread");
+        GzipParallel_compressBlocks(m_rJob);
+        
+        //job is owned by waiting thread - do not touch it after unlock
+        std::lock_guard<std::mutex> rGuard(m_rJob.m_lock);
+        --m_rJob.m_workers;
+        m_rJob.m_cond.notify_one();
+        return true;
+    }
+    
+private:
+    GzipParallelJob &m_rJob;
+};
+
+int CommonFunctions::compressGzipParallel(int compressionLevel,
+                                          const uint8 *pData,
+                                          size_t dataLen,
+                                          ByteBuffer &rBuffOut,
+                                          size_t blockSize,
+                                          uint32 threadCount)
+{
+    if(blockSize == 0)
+    {
+        blockSize = GZIP_PARALLEL_BLOCK_SIZE;
+    }
+    
+    if(threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    
+    GzipParallelJob rJob;
+    rJob.m_pData = pData;
+    rJob.m_dataLen = dataLen;
+    rJob.m_blockSize = blockSize;
+    rJob.m_blockCount = std::max<size_t>((dataLen + blockSize - 1) / blockSize, 1);
+    rJob.m_compressionLevel = compressionLevel;
+    rJob.m_nextBlock = 0;
+    rJob.m_result = Z_OK;
+    rJob.m_blocks.resize(rJob.m_blockCount);
+    rJob.m_crcs.resize(rJob.m_blockCount);
+    rJob.m_workers = static_cast<uint32>(std::min<size_t>(threadCount, rJob.m_blockCount) - 1);
+    
+    //calling thread is one of workers
+    for(uint32 i = 0;i < rJob.m_workers;++i)
+    {
+        ThreadPool.ExecuteTask(new GzipParallelWorker(rJob));
+    }
+    GzipParallel_compressBlocks(rJob);
+    
+    {
+        std::unique_lock<std::mutex> rGuard(rJob.m_lock);
+        while(rJob.m_workers != 0)
+        {
+            rJob.m_cond.wait(rGuard);
+        }
+    }
+    
+    if(rJob.m_result != Z_OK)
+        return rJob.m_result;
+    
+    //we need clean buffer
+    size_t outSize = 18;
+    for(size_t i = 0;i < rJob.m_blockCount;++i)
+    {
+        outSize += rJob.m_blocks[i].size();
+    }
+    rBuffOut.resize(0);
+    rBuffOut.reserve(outSize);
+    
+    //gzip header - no name, no time, unix
+    static const uint8 gzipHeader[10] = { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3 };
+    rBuffOut.append(gzipHeader, sizeof(gzipHeader));
+    
+    //blocks and crc of whole input
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for(size_t i = 0;i < rJob.m_blockCount;++i)
+    {
+        size_t length = std::min(blockSize, dataLen - std::min(dataLen, i * blockSize));
+        rBuffOut.append(rJob.m_blocks[i].contents(), rJob.m_blocks[i].size());
+        crc = crc32_combine(crc, rJob.m_crcs[i], static_cast<z_off_t>(length));
+    }
+    
+    //trailer - crc32 and size mod 2^32, little endian
+    uint8 trailer[8];
+    uint32 isize = static_cast<uint32>(dataLen);
+    for(int i = 0;i < 4;++i)
+    {
+        trailer[i] = static_cast<uint8>(crc >> (8 * i));
+        trailer[i + 4] = static_cast<uint8>(isize >> (8 * i));
+    }
+    rBuffOut.append(trailer, sizeof(trailer));
+    return Z_OK;
+}
+
 bool CommonFunctions::CheckFileExists(const char *pFileName, bool oCreate)
 {
 	bool oReturnVal = true;
@@ -24,11 +24,20 @@
 #include "Packets/ByteBuffer.h"
 #include "zlib/zlib.h"
 
+#ifndef GZIP_PARALLEL_THRESHOLD
+    #define GZIP_PARALLEL_THRESHOLD     (8 * 1024 * 1024)   //compressGzip uses parallel mode for larger payloads
+#endif
+#ifndef GZIP_PARALLEL_BLOCK_SIZE
+    #define GZIP_PARALLEL_BLOCK_SIZE    (256 * 1024)
+#endif
+
 class CommonFunctions
 {
 public:
 	static int decompressGzip(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut, int zlibBufferSize);
 	static int compressGzip(int compressionLevel, const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut, int zlibBufferSize);
+    //pigz style - blocks are compressed on ThreadPool (with previous 32KB as dictionary) and joined to one gzip member, threadCount 0 = all cores
+	static int compressGzipParallel(int compressionLevel, const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut, size_t blockSize = GZIP_PARALLEL_BLOCK_SIZE, uint32 threadCount = 0);
     static INLINE bool isGziped(const uint8 *pData)
     {
         return (pData[0] == 0x1f) && (pData[1] == 0x8b);
@@ -0,0 +1,416 @@
+//
+//  ConcurrentHashMap.h
+//
+//  Thread-safe hash map with the same interface as HashMap.
+//  Keys are striped across shards, writers lock one shard. Readers take no lock - chains are published
+//  with release stores and nodes are never changed after publish (put of existing key replaces node).
+//  Unlinked nodes are freed after grace period: readers mark two-phase epoch counter (per thread slot),
+//  writer flips epoch and waits until readers of previous epoch leave.
+//
+
+#ifndef TransDB_ConcurrentHashMap_h
+#define TransDB_ConcurrentHashMap_h
+
+#include "FlatHashMap.h"
+
+#define CONCURRENT_HASH_MAP_SHARDS          64      //power of 2
+#define CONCURRENT_HASH_MAP_READER_SLOTS    64      //epoch counters, threads are spread over them
+#define CONCURRENT_HASH_MAP_RETIRE_BATCH    128     //unlinked nodes per shard before grace period
+
+// Concurrent hash map class template
+template <class K, class V, class _Hasher = FlatHashMapHasher<K> >
+class ConcurrentHashMap
+{
+    /** Immutable after publish except m_pNext
+     */
+    struct Node
+    {
+        explicit Node(const K &key, const V &value, Node *pNext) : m_key(key), m_value(value), m_pNext(pNext)
+        {
+        }
+
+        const K                 m_key;
+        const V                 m_value;
+        std::atomic<Node*>      m_pNext;
+    };
+
+    struct Buckets
+    {
+        explicit Buckets(uint64 size) : m_mask(size - 1), m_pTable(new std::atomic<Node*>[size])
+        {
+            for(uint64 i = 0;i < size;++i)
+            {
+                m_pTable[i].store(NULL, std::memory_order_relaxed);
+            }
+        }
+
+        ~Buckets()
+        {
+            delete [] m_pTable;
+        }
+
+        uint64                  m_mask;
+        std::atomic<Node*>      *m_pTable;
+    };
+
+    /** Shard - writers are serialized by m_writeLock
+     */
+    struct Shard
+    {
+        Shard() : m_pBuckets(new Buckets(16)), m_count(0)
+        {
+        }
+
+        std::mutex              m_writeLock;
+        std::atomic<Buckets*>   m_pBuckets;
+        std::atomic<uint64>     m_count;
+        std::vector<Node*>      m_retiredNodes;     //guarded by m_writeLock
+        std::vector<Buckets*>   m_retiredBuckets;
+        char                    m_pad[64];
+    };
+
+    /** Readers of epoch parity 0/1 - one cache line per slot
+     */
+    struct ReaderSlot
+    {
+        ReaderSlot()
+        {
+            m_readers[0].store(0, std::memory_order_relaxed);
+            m_readers[1].store(0, std::memory_order_relaxed);
+        }
+
+        std::atomic<uint32>     m_readers[2];
+        char                    m_pad[64 - 2 * sizeof(std::atomic<uint32>)];
+    };
+
+    /** Read-side section - readers never wait
+     */
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(ConcurrentHashMap &rMap) : m_rSlot(rMap.m_rReaders[readerSlot()])
+        {
+            for(;;)
+            {
+                m_parity = rMap.m_epoch.load(std::memory_order_seq_cst) & 1;
+                m_rSlot.m_readers[m_parity].fetch_add(1, std::memory_order_seq_cst);
+                //epoch flipped in between - writer may not wait for us
+                if((rMap.m_epoch.load(std::memory_order_seq_cst) & 1) == m_parity)
+                    break;
+
+                m_rSlot.m_readers[m_parity].fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        ~ReadGuard()
+        {
+            m_rSlot.m_readers[m_parity].fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ReadGuard);
+
+        ReaderSlot      &m_rSlot;
+        uint32          m_parity;
+    };
+
+public:
+    /** @param tableSize expected number of records, split between shards
+     */
+    explicit ConcurrentHashMap(const uint64 &tableSize = 0) : m_epoch(0)
+    {
+        uint64 shardSize = tableSize / CONCURRENT_HASH_MAP_SHARDS;
+        for(uint32 i = 0;shardSize > 16 && i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            delete m_rShards[i].m_pBuckets.load(std::memory_order_relaxed);
+            m_rShards[i].m_pBuckets.store(new Buckets(nextPow2(shardSize)), std::memory_order_relaxed);
+        }
+    }
+
+    ~ConcurrentHashMap()
+    {
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            Shard &rShard = m_rShards[i];
+            Buckets *pBuckets = rShard.m_pBuckets.load(std::memory_order_relaxed);
+            for(uint64 b = 0;b <= pBuckets->m_mask;++b)
+            {
+                Node *pEntry = pBuckets->m_pTable[b].load(std::memory_order_relaxed);
+                while(pEntry != NULL)
+                {
+                    Node *pNext = pEntry->m_pNext.load(std::memory_order_relaxed);
+                    delete pEntry;
+                    pEntry = pNext;
+                }
+            }
+            delete pBuckets;
+            freeRetired(rShard);
+        }
+    }
+
+    /** Approximate while other threads write
+     */
+    INLINE uint64 size() const NOEXCEPT
+    {
+        uint64 count = 0;
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            count += m_rShards[i].m_count.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    INLINE void clear()
+    {
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            Shard &rShard = m_rShards[i];
+            std::lock_guard<std::mutex> rGuard(rShard.m_writeLock);
+            Buckets *pBuckets = rShard.m_pBuckets.load(std::memory_order_relaxed);
+            for(uint64 b = 0;b <= pBuckets->m_mask;++b)
+            {
+                Node *pEntry = pBuckets->m_pTable[b].exchange(NULL, std::memory_order_release);
+                while(pEntry != NULL)
+                {
+                    rShard.m_retiredNodes.push_back(pEntry);
+                    pEntry = pEntry->m_pNext.load(std::memory_order_relaxed);
+                }
+            }
+            rShard.m_count.store(0, std::memory_order_relaxed);
+            reclaim(rShard);
+        }
+    }
+
+    INLINE void getAllValues(Vector<V, uint64> &rValues)
+    {
+        ReadGuard rGuard(*this);
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            Buckets *pBuckets = m_rShards[i].m_pBuckets.load(std::memory_order_acquire);
+            for(uint64 b = 0;b <= pBuckets->m_mask;++b)
+            {
+                for(Node *pEntry = pBuckets->m_pTable[b].load(std::memory_order_acquire);pEntry != NULL;pEntry = pEntry->m_pNext.load(std::memory_order_acquire))
+                {
+                    rValues.push_back(pEntry->m_value);
+                }
+            }
+        }
+    }
+
+    INLINE void getKeyValuePairs(Vector<std::pair<K, V> > &rPairs)
+    {
+        ReadGuard rGuard(*this);
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_SHARDS;++i)
+        {
+            Buckets *pBuckets = m_rShards[i].m_pBuckets.load(std::memory_order_acquire);
+            for(uint64 b = 0;b <= pBuckets->m_mask;++b)
+            {
+                for(Node *pEntry = pBuckets->m_pTable[b].load(std::memory_order_acquire);pEntry != NULL;pEntry = pEntry->m_pNext.load(std::memory_order_acquire))
+                {
+                    rPairs.push_back(std::pair<K, V>(pEntry->m_key, pEntry->m_value));
+                }
+            }
+        }
+    }
+
+    /** Lock-free
+     */
+    INLINE bool containsKey(const K &key)
+    {
+        uint64 hash = m_rHasher(key);
+        ReadGuard rGuard(*this);
+        return find(shard(hash), key, hash) != NULL;
+    }
+
+    /** Lock-free
+     */
+    INLINE bool get(const K &key, V &value)
+    {
+        uint64 hash = m_rHasher(key);
+        ReadGuard rGuard(*this);
+        Node *pEntry = find(shard(hash), key, hash);
+        if(pEntry != NULL)
+        {
+            value = pEntry->m_value;
+            return true;
+        }
+        return false;
+    }
+
+    INLINE void put(const K &key, const V &value)
+    {
+        uint64 hash = m_rHasher(key);
+        Shard &rShard = shard(hash);
+        std::lock_guard<std::mutex> rGuard(rShard.m_writeLock);
+
+        Buckets *pBuckets = rShard.m_pBuckets.load(std::memory_order_relaxed);
+        std::atomic<Node*> *pLink = &pBuckets->m_pTable[hash & pBuckets->m_mask];
+        Node *pEntry = pLink->load(std::memory_order_relaxed);
+        while(pEntry != NULL && !(pEntry->m_key == key))
+        {
+            pLink = &pEntry->m_pNext;
+            pEntry = pLink->load(std::memory_order_relaxed);
+        }
+
+        if(pEntry != NULL)
+        {
+            //replace node - readers see old or new value, never torn one
+            pLink->store(new Node(key, value, pEntry->m_pNext.load(std::memory_order_relaxed)), std::memory_order_release);
+            retire(rShard, pEntry);
+            return;
+        }
+
+        //new key - at the end of chain
+        pLink->store(new Node(key, value, NULL), std::memory_order_release);
+        if(rShard.m_count.fetch_add(1, std::memory_order_relaxed) + 1 > pBuckets->m_mask + 1)
+        {
+            grow(rShard);
+        }
+    }
+
+    INLINE void remove(const K &key)
+    {
+        uint64 hash = m_rHasher(key);
+        Shard &rShard = shard(hash);
+        std::lock_guard<std::mutex> rGuard(rShard.m_writeLock);
+
+        Buckets *pBuckets = rShard.m_pBuckets.load(std::memory_order_relaxed);
+        std::atomic<Node*> *pLink = &pBuckets->m_pTable[hash & pBuckets->m_mask];
+        Node *pEntry = pLink->load(std::memory_order_relaxed);
+        while(pEntry != NULL && !(pEntry->m_key == key))
+        {
+            pLink = &pEntry->m_pNext;
+            pEntry = pLink->load(std::memory_order_relaxed);
+        }
+
+        if(pEntry != NULL)
+        {
+            //readers standing on removed node still continue to its successor
+            pLink->store(pEntry->m_pNext.load(std::memory_order_relaxed), std::memory_order_release);
+            rShard.m_count.fetch_sub(1, std::memory_order_relaxed);
+            retire(rShard, pEntry);
+        }
+    }
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(ConcurrentHashMap);
+
+    /** Reader slot of current thread
+     */
+    static INLINE uint32 readerSlot() NOEXCEPT
+    {
+        static std::atomic<uint32> s_nextSlot(0);
+        static thread_local uint32 t_slot = s_nextSlot.fetch_add(1, std::memory_order_relaxed) % CONCURRENT_HASH_MAP_READER_SLOTS;
+        return t_slot;
+    }
+
+    //shard by high bits, bucket by low bits
+    INLINE Shard &shard(uint64 hash) NOEXCEPT
+    {
+        return m_rShards[(hash >> 58) & (CONCURRENT_HASH_MAP_SHARDS - 1)];
+    }
+
+    INLINE Node *find(Shard &rShard, const K &key, uint64 hash) NOEXCEPT
+    {
+        Buckets *pBuckets = rShard.m_pBuckets.load(std::memory_order_acquire);
+        Node *pEntry = pBuckets->m_pTable[hash & pBuckets->m_mask].load(std::memory_order_acquire);
+        while(pEntry != NULL)
+        {
+            if(pEntry->m_key == key)
+                return pEntry;
+
+            pEntry = pEntry->m_pNext.load(std::memory_order_acquire);
+        }
+        return NULL;
+    }
+
+    /** Doubles bucket array - nodes are copied, readers still walk old chains
+     */
+    void grow(Shard &rShard)
+    {
+        Buckets *pOld = rShard.m_pBuckets.load(std::memory_order_relaxed);
+        Buckets *pNew = new Buckets((pOld->m_mask + 1) * 2);
+        for(uint64 b = 0;b <= pOld->m_mask;++b)
+        {
+            for(Node *pEntry = pOld->m_pTable[b].load(std::memory_order_relaxed);pEntry != NULL;pEntry = pEntry->m_pNext.load(std::memory_order_relaxed))
+            {
+                std::atomic<Node*> &rBucket = pNew->m_pTable[m_rHasher(pEntry->m_key) & pNew->m_mask];
+                rBucket.store(new Node(pEntry->m_key, pEntry->m_value, rBucket.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+                rShard.m_retiredNodes.push_back(pEntry);
+            }
+        }
+        rShard.m_pBuckets.store(pNew, std::memory_order_release);
+        rShard.m_retiredBuckets.push_back(pOld);
+        reclaim(rShard);
+    }
+
+    INLINE void retire(Shard &rShard, Node *pEntry)
+    {
+        rShard.m_retiredNodes.push_back(pEntry);
+        if(rShard.m_retiredNodes.size() >= CONCURRENT_HASH_MAP_RETIRE_BATCH)
+        {
+            reclaim(rShard);
+        }
+    }
+
+    /** Waits for grace period and frees retired nodes of shard
+     */
+    void reclaim(Shard &rShard)
+    {
+        synchronize();
+        freeRetired(rShard);
+    }
+
+    /** Returns when all readers which could see unlinked nodes have left
+     */
+    void synchronize()
+    {
+        std::lock_guard<std::mutex> rGuard(m_syncLock);
+        uint32 parity = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+        for(uint32 i = 0;i < CONCURRENT_HASH_MAP_READER_SLOTS;++i)
+        {
+            while(m_rReaders[i].m_readers[parity].load(std::memory_order_seq_cst) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void freeRetired(Shard &rShard)
+    {
+        for(size_t i = 0;i < rShard.m_retiredNodes.size();++i)
+        {
+            delete rShard.m_retiredNodes[i];
+        }
+        rShard.m_retiredNodes.clear();
+
+        for(size_t i = 0;i < rShard.m_retiredBuckets.size();++i)
+        {
+            delete rShard.m_retiredBuckets[i];
+        }
+        rShard.m_retiredBuckets.clear();
+    }
+
+    //
+    INLINE uint64 nextPow2(uint64 x)
+    {
+        --x;
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        x |= x >> 32;
+        return x+1;
+    }
+
+    //
+    Shard               m_rShards[CONCURRENT_HASH_MAP_SHARDS];
+    ReaderSlot          m_rReaders[CONCURRENT_HASH_MAP_READER_SLOTS];
+    std::atomic<uint32> m_epoch;
+    std::mutex          m_syncLock;
+    _Hasher             m_rHasher;
+};
+
+#endif
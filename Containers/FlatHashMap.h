@@ -0,0 +1,427 @@
+//
+//  FlatHashMap.h
+//
+//  Open-addressing hash map with the same interface as HashMap.
+//  Slots are stored flat in groups of 15 with 16 control bytes per group (15 hash tags + overflow bits),
+//  group is matched with one SSE2 compare. Lookup stops at first group without overflow bit of the key,
+//  so erase only clears control byte - no tombstones. Erases from overflowed groups leave stale overflow bits,
+//  they are counted against load and cleared by rehash. Growth migrates few groups per put/remove.
+//
+
+#ifndef TransDB_FlatHashMap_h
+#define TransDB_FlatHashMap_h
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define FLAT_HASH_MAP_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#define FLAT_HASH_MAP_GROUP_SLOTS       15
+#define FLAT_HASH_MAP_GROUP_SIZE        16      //control bytes per group, last one holds overflow bits
+#define FLAT_HASH_MAP_MIGRATE_GROUPS    4       //old groups moved per put/remove while growing
+
+// Default hasher - murmur3 finalizer, spreads strided integer keys
+template <class K>
+struct FlatHashMapHasher
+{
+    INLINE uint64 operator()(const K &key) const NOEXCEPT
+    {
+        uint64 h = static_cast<uint64>(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// Slot - key-value pair
+template <class K, class V>
+struct FlatHashMapSlot
+{
+    explicit FlatHashMapSlot(const K &key, const V &value) : m_key(key), m_value(value)
+    {
+    }
+
+    K   m_key;
+    V   m_value;
+};
+
+// Flat hash map class template
+template <class K, class V, class _Hasher = FlatHashMapHasher<K> >
+class FlatHashMap
+{
+    typedef FlatHashMapSlot<K, V>       SlotT;
+
+    struct Table
+    {
+        uint8       *m_pCtrl;
+        SlotT       *m_pSlots;
+        uint64      m_groupMask;
+        uint64      m_count;
+        uint64      m_maxCount;     //7/8 load
+        uint64      m_erasedOverflow;   //slots erased from groups with overflow bits - stale bits make probes longer
+    };
+
+    static const uint64 NOT_FOUND = ~0ULL;
+
+public:
+    explicit FlatHashMap(const uint64 &tableSize = 16)
+    {
+        uint64 groups = (tableSize * 8 / 7 + FLAT_HASH_MAP_GROUP_SLOTS - 1) / FLAT_HASH_MAP_GROUP_SLOTS;
+        allocTable(m_rTable, nextPow2(groups < 1 ? 1 : groups));
+        memset(&m_rOld, 0, sizeof(Table));
+        m_migrateGroup = 0;
+    }
+
+    ~FlatHashMap()
+    {
+        freeTable(m_rTable);
+        freeTable(m_rOld);
+    }
+
+    INLINE uint64 size() const NOEXCEPT
+    {
+        return m_rTable.m_count + m_rOld.m_count;
+    }
+
+    INLINE void clear() NOEXCEPT
+    {
+        uint64 groups = m_rTable.m_groupMask + 1;
+        freeTable(m_rOld);
+        freeTable(m_rTable);
+        allocTable(m_rTable, groups);
+    }
+
+    INLINE void getAllValues(Vector<V, uint64> &rValues)
+    {
+        const Table *tables[2] = { &m_rTable, &m_rOld };
+        for(int t = 0;t < 2;++t)
+        {
+            const Table &rTable = *tables[t];
+            for(uint64 i = 0;rTable.m_count != 0 && i < slotCount(rTable);++i)
+            {
+                if(isFull(rTable, i))
+                {
+                    rValues.push_back(rTable.m_pSlots[i].m_value);
+                }
+            }
+        }
+    }
+
+    INLINE void getKeyValuePairs(Vector<std::pair<K, V> > &rPairs)
+    {
+        const Table *tables[2] = { &m_rTable, &m_rOld };
+        for(int t = 0;t < 2;++t)
+        {
+            const Table &rTable = *tables[t];
+            for(uint64 i = 0;rTable.m_count != 0 && i < slotCount(rTable);++i)
+            {
+                if(isFull(rTable, i))
+                {
+                    rPairs.push_back(std::pair<K, V>(rTable.m_pSlots[i].m_key, rTable.m_pSlots[i].m_value));
+                }
+            }
+        }
+    }
+
+    INLINE bool containsKey(const K &key) NOEXCEPT
+    {
+        uint64 hash = m_rHasher(key);
+        return find(m_rTable, key, hash) != NOT_FOUND || (m_rOld.m_count != 0 && find(m_rOld, key, hash) != NOT_FOUND);
+    }
+
+    INLINE bool get(const K &key, V &value) NOEXCEPT
+    {
+        uint64 hash = m_rHasher(key);
+        uint64 index = find(m_rTable, key, hash);
+        if(index != NOT_FOUND)
+        {
+            value = m_rTable.m_pSlots[index].m_value;
+            return true;
+        }
+
+        if(m_rOld.m_count != 0 && (index = find(m_rOld, key, hash)) != NOT_FOUND)
+        {
+            value = m_rOld.m_pSlots[index].m_value;
+            return true;
+        }
+        return false;
+    }
+
+    INLINE void put(const K &key, const V &value)
+    {
+        migrate();
+
+        uint64 hash = m_rHasher(key);
+        uint64 index = find(m_rTable, key, hash);
+        if(index != NOT_FOUND)
+        {
+            m_rTable.m_pSlots[index].m_value = value;
+            return;
+        }
+
+        //key lives in exactly one table, not migrated yet
+        if(m_rOld.m_count != 0 && (index = find(m_rOld, key, hash)) != NOT_FOUND)
+        {
+            m_rOld.m_pSlots[index].m_value = value;
+            return;
+        }
+
+        if(m_rTable.m_count + m_rTable.m_erasedOverflow >= m_rTable.m_maxCount)
+        {
+            rehash();
+        }
+        insert(m_rTable, hash, SlotT(key, value));
+    }
+
+    INLINE void remove(const K &key)
+    {
+        migrate();
+
+        uint64 hash = m_rHasher(key);
+        uint64 index = find(m_rTable, key, hash);
+        if(index != NOT_FOUND)
+        {
+            erase(m_rTable, index);
+        }
+        else if(m_rOld.m_count != 0 && (index = find(m_rOld, key, hash)) != NOT_FOUND)
+        {
+            erase(m_rOld, index);
+        }
+    }
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(FlatHashMap);
+
+    /** Hash tag in control byte, 0 = empty slot
+     */
+    static INLINE uint8 tag(uint64 hash) NOEXCEPT
+    {
+        uint8 value = static_cast<uint8>(hash >> 56);
+        return value != 0 ? value : 1;
+    }
+
+    /** Overflow bit - set on full group when insert continues to next one
+     */
+    static INLINE uint8 overflowBit(uint64 hash) NOEXCEPT
+    {
+        return static_cast<uint8>(1 << ((hash >> 48) & 7));
+    }
+
+    /** Bit mask of slots in group with control byte equal to value
+     */
+    static INLINE uint32 match(const uint8 *pGroup, uint8 value) NOEXCEPT
+    {
+#ifdef FLAT_HASH_MAP_SSE2
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(pGroup));
+        return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(value))))) & 0x7FFF;
+#else
+        uint32 mask = 0;
+        for(uint32 i = 0;i < FLAT_HASH_MAP_GROUP_SLOTS;++i)
+        {
+            mask |= static_cast<uint32>(pGroup[i] == value) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static INLINE uint32 lowestBit(uint32 mask) NOEXCEPT
+    {
+#ifdef WIN32
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<uint32>(__builtin_ctz(mask));
+#endif
+    }
+
+    static INLINE uint64 slotCount(const Table &rTable) NOEXCEPT
+    {
+        return rTable.m_pCtrl != NULL ? (rTable.m_groupMask + 1) * FLAT_HASH_MAP_GROUP_SLOTS : 0;
+    }
+
+    static INLINE bool isFull(const Table &rTable, uint64 index) NOEXCEPT
+    {
+        return rTable.m_pCtrl[(index / FLAT_HASH_MAP_GROUP_SLOTS) * FLAT_HASH_MAP_GROUP_SIZE + index % FLAT_HASH_MAP_GROUP_SLOTS] != 0;
+    }
+
+    /** Returns slot index or NOT_FOUND, groups are probed triangular (visits all groups)
+     */
+    INLINE uint64 find(const Table &rTable, const K &key, uint64 hash) const NOEXCEPT
+    {
+        uint8 keyTag = tag(hash);
+        uint8 keyOverflow = overflowBit(hash);
+        uint64 group = hash & rTable.m_groupMask;
+
+        for(uint64 step = 0;step <= rTable.m_groupMask;)
+        {
+            const uint8 *pGroup = rTable.m_pCtrl + group * FLAT_HASH_MAP_GROUP_SIZE;
+            uint32 mask = match(pGroup, keyTag);
+            while(mask != 0)
+            {
+                uint64 index = group * FLAT_HASH_MAP_GROUP_SLOTS + lowestBit(mask);
+                if(rTable.m_pSlots[index].m_key == key)
+                    return index;
+
+                mask &= mask - 1;
+            }
+
+            //nothing was pushed over this group
+            if((pGroup[FLAT_HASH_MAP_GROUP_SLOTS] & keyOverflow) == 0)
+                break;
+
+            ++step;
+            group = (group + step) & rTable.m_groupMask;
+        }
+        return NOT_FOUND;
+    }
+
+    /** Inserts key which is not in table, table must have free slot
+     */
+    INLINE void insert(Table &rTable, uint64 hash, const SlotT &rSlot)
+    {
+        uint64 group = hash & rTable.m_groupMask;
+        for(uint64 step = 0;;)
+        {
+            uint8 *pGroup = rTable.m_pCtrl + group * FLAT_HASH_MAP_GROUP_SIZE;
+            uint32 mask = match(pGroup, 0);
+            if(mask != 0)
+            {
+                uint32 slot = lowestBit(mask);
+                pGroup[slot] = tag(hash);
+                new(&rTable.m_pSlots[group * FLAT_HASH_MAP_GROUP_SLOTS + slot]) SlotT(rSlot);
+                ++rTable.m_count;
+                return;
+            }
+
+            pGroup[FLAT_HASH_MAP_GROUP_SLOTS] |= overflowBit(hash);
+            ++step;
+            group = (group + step) & rTable.m_groupMask;
+        }
+    }
+
+    INLINE void erase(Table &rTable, uint64 index)
+    {
+        uint8 *pGroup = rTable.m_pCtrl + (index / FLAT_HASH_MAP_GROUP_SLOTS) * FLAT_HASH_MAP_GROUP_SIZE;
+        pGroup[index % FLAT_HASH_MAP_GROUP_SLOTS] = 0;
+        if(pGroup[FLAT_HASH_MAP_GROUP_SLOTS] != 0)
+        {
+            ++rTable.m_erasedOverflow;
+        }
+        rTable.m_pSlots[index].~SlotT();
+        --rTable.m_count;
+    }
+
+    /** Starts incremental rehash to table with double size or rebuilds table with same size
+     * when load is made mostly by stale overflow bits (remove+put churn at steady size)
+     */
+    void rehash()
+    {
+        //previous growth is not finished (only after many removes and puts) - finish it now
+        while(m_rOld.m_pCtrl != NULL)
+        {
+            migrate();
+        }
+
+        if(m_rTable.m_count >= m_rTable.m_maxCount * 3 / 4)
+        {
+            m_rOld = m_rTable;
+            m_migrateGroup = 0;
+            allocTable(m_rTable, (m_rOld.m_groupMask + 1) * 2);
+        }
+        else
+        {
+            Table rOld = m_rTable;
+            allocTable(m_rTable, rOld.m_groupMask + 1);
+            for(uint64 i = 0;i < slotCount(rOld);++i)
+            {
+                if(isFull(rOld, i))
+                {
+                    insert(m_rTable, m_rHasher(rOld.m_pSlots[i].m_key), rOld.m_pSlots[i]);
+                }
+            }
+            freeTable(rOld);
+        }
+    }
+
+    /** Moves few groups from old table
+     */
+    INLINE void migrate()
+    {
+        if(m_rOld.m_pCtrl == NULL)
+            return;
+
+        for(uint32 i = 0;i < FLAT_HASH_MAP_MIGRATE_GROUPS && m_migrateGroup <= m_rOld.m_groupMask;++i, ++m_migrateGroup)
+        {
+            //overflow bits stay - keys in later groups are still found
+            uint8 *pGroup = m_rOld.m_pCtrl + m_migrateGroup * FLAT_HASH_MAP_GROUP_SIZE;
+            for(uint32 slot = 0;slot < FLAT_HASH_MAP_GROUP_SLOTS;++slot)
+            {
+                if(pGroup[slot] != 0)
+                {
+                    SlotT &rSlot = m_rOld.m_pSlots[m_migrateGroup * FLAT_HASH_MAP_GROUP_SLOTS + slot];
+                    insert(m_rTable, m_rHasher(rSlot.m_key), rSlot);
+                    erase(m_rOld, m_migrateGroup * FLAT_HASH_MAP_GROUP_SLOTS + slot);
+                }
+            }
+        }
+
+        if(m_migrateGroup > m_rOld.m_groupMask)
+        {
+            freeTable(m_rOld);
+        }
+    }
+
+    void allocTable(Table &rTable, uint64 groups)
+    {
+        rTable.m_pCtrl = static_cast<uint8*>(_ALIGNED_MALLOC(groups * FLAT_HASH_MAP_GROUP_SIZE, 64));
+        memset(rTable.m_pCtrl, 0, groups * FLAT_HASH_MAP_GROUP_SIZE);
+        rTable.m_pSlots = static_cast<SlotT*>(_MALLOC(groups * FLAT_HASH_MAP_GROUP_SLOTS * sizeof(SlotT)));
+        rTable.m_groupMask = groups - 1;
+        rTable.m_count = 0;
+        rTable.m_maxCount = groups * FLAT_HASH_MAP_GROUP_SLOTS * 7 / 8;
+        rTable.m_erasedOverflow = 0;
+    }
+
+    void freeTable(Table &rTable)
+    {
+        if(rTable.m_pCtrl == NULL)
+            return;
+
+        for(uint64 i = 0;rTable.m_count != 0 && i < slotCount(rTable);++i)
+        {
+            if(isFull(rTable, i))
+            {
+                erase(rTable, i);
+            }
+        }
+        _ALIGNED_FREE(rTable.m_pCtrl);
+        _FREE(rTable.m_pSlots);
+        memset(&rTable, 0, sizeof(Table));
+    }
+
+    //
+    INLINE uint64 nextPow2(uint64 x)
+    {
+        --x;
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        x |= x >> 32;
+        return x+1;
+    }
+
+    //
+    Table               m_rTable;
+    Table               m_rOld;         //table being migrated during growth
+    uint64              m_migrateGroup;
+    _Hasher             m_rHasher;
+};
+
+#endif
@@ -0,0 +1,345 @@
+//
+//  MPMCRing.h
+//
+//  Bounded lock-free multi-producer/multi-consumer ring with per-cell sequence numbers (Dmitry Vyukov).
+//  Blocking calls sleep only after spinning, producers/consumers signal only when somebody sleeps.
+//
+
+#ifndef TransDB_MPMCRing_h
+#define TransDB_MPMCRing_h
+
+#define MPMC_RING_SPIN_COUNT    64      //failed tries before blocking call goes to sleep
+
+template <class T>
+class MPMCRing
+{
+    struct Cell
+    {
+        std::atomic<size_t>     m_sequence;
+        T                       m_data;
+    };
+
+    /** Sleeping side of ring, lock is taken only when m_waiters != 0
+     */
+    struct Waiters
+    {
+        Waiters() : m_waiters(0), m_epoch(0)
+        {
+        }
+
+        std::atomic<uint32>         m_waiters;
+        uint64                      m_epoch;        //guarded by m_lock
+        std::mutex                  m_lock;
+        std::condition_variable     m_cond;
+    };
+
+public:
+    /** @param capacity rounded up to power of 2
+     */
+    explicit MPMCRing(size_t capacity) : m_aborted(false)
+    {
+        m_mask = nextPow2(capacity < 2 ? 2 : capacity) - 1;
+        m_pCells = new Cell[m_mask + 1];
+        for(size_t i = 0;i <= m_mask;++i)
+        {
+            m_pCells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~MPMCRing()
+    {
+        delete [] m_pCells;
+    }
+
+    INLINE size_t capacity() const NOEXCEPT
+    {
+        return m_mask + 1;
+    }
+
+    /** Return the approximate size of the queue (not reliable!).
+     */
+    INLINE size_t size() const NOEXCEPT
+    {
+        size_t enqueuePos = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeuePos = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    /** Non-blocking put, returns false when ring is full
+     */
+    bool try_put(const T &item)
+    {
+        return try_put(&item, 1) == 1;
+    }
+
+    /** Non-blocking get, returns false when ring is empty
+     */
+    bool try_get(T &item)
+    {
+        return try_get(&item, 1) == 1;
+    }
+
+    /** Non-blocking batch put - claims as many free cells as possible with one CAS
+     * @return number of items put (prefix of pItems)
+     */
+    size_t try_put(const T *pItems, size_t count)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t claimed;
+        for(;;)
+        {
+            claimed = 0;
+            while(claimed < count && claimed <= m_mask)
+            {
+                intptr_t diff = static_cast<intptr_t>(m_pCells[(pos + claimed) & m_mask].m_sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + claimed);
+                if(diff != 0)
+                {
+                    //other producer moved - reload position
+                    if(claimed == 0 && diff > 0)
+                    {
+                        claimed = SIZE_MAX;
+                    }
+                    break;
+                }
+                ++claimed;
+            }
+
+            if(claimed == SIZE_MAX)
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            //full
+            if(claimed == 0)
+                return 0;
+
+            if(m_enqueuePos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+                break;
+        }
+
+        for(size_t i = 0;i < claimed;++i)
+        {
+            Cell &rCell = m_pCells[(pos + i) & m_mask];
+            rCell.m_data = pItems[i];
+            rCell.m_sequence.store(pos + i + 1, std::memory_order_release);
+        }
+
+        signal(m_rGetWaiters, claimed);
+        return claimed;
+    }
+
+    /** Non-blocking batch get
+     * @return number of items stored to pItems
+     */
+    size_t try_get(T *pItems, size_t count)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        size_t claimed;
+        for(;;)
+        {
+            claimed = 0;
+            while(claimed < count && claimed <= m_mask)
+            {
+                intptr_t diff = static_cast<intptr_t>(m_pCells[(pos + claimed) & m_mask].m_sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + claimed + 1);
+                if(diff != 0)
+                {
+                    //other consumer moved - reload position
+                    if(claimed == 0 && diff > 0)
+                    {
+                        claimed = SIZE_MAX;
+                    }
+                    break;
+                }
+                ++claimed;
+            }
+
+            if(claimed == SIZE_MAX)
+            {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            //empty
+            if(claimed == 0)
+                return 0;
+
+            if(m_dequeuePos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+                break;
+        }
+
+        for(size_t i = 0;i < claimed;++i)
+        {
+            Cell &rCell = m_pCells[(pos + i) & m_mask];
+            pItems[i] = std::move(rCell.m_data);
+            rCell.m_sequence.store(pos + i + m_mask + 1, std::memory_order_release);
+        }
+
+        signal(m_rPutWaiters, claimed);
+        return claimed;
+    }
+
+    /** Blocking put, waits until there is free space or abort() is called
+     */
+    bool put(const T &item)
+    {
+        return wait(m_rPutWaiters, &MPMCRing::try_put_one, const_cast<T*>(&item), NULL);
+    }
+
+    /** Blocking put with timeout (std::chrono::milliseconds, std::chrono::microseconds, ...)
+     */
+    template<class Rep, class Period>
+    bool put(const T &item, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+        return wait(m_rPutWaiters, &MPMCRing::try_put_one, const_cast<T*>(&item), &deadline);
+    }
+
+    /** Blocking get, waits until there is item or abort() is called
+     */
+    bool get(T &item)
+    {
+        return wait(m_rGetWaiters, &MPMCRing::try_get_one, &item, NULL);
+    }
+
+    /** Blocking get with timeout (std::chrono::milliseconds, std::chrono::microseconds, ...)
+     */
+    template<class Rep, class Period>
+    bool get(T &item, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+        return wait(m_rGetWaiters, &MPMCRing::try_get_one, &item, &deadline);
+    }
+
+    /** unblock all waiting threads, blocking calls fail until reset()
+     */
+    void abort()
+    {
+        m_aborted = true;
+        wakeAll(m_rGetWaiters);
+        wakeAll(m_rPutWaiters);
+    }
+
+    /** allow blocking calls after abort()
+     */
+    INLINE void reset() NOEXCEPT
+    {
+        m_aborted = false;
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(MPMCRing);
+
+    typedef bool (MPMCRing::*TryFunc)(T *pItem);
+
+    bool try_put_one(T *pItem)  { return try_put(pItem, 1) == 1; }
+    bool try_get_one(T *pItem)  { return try_get(pItem, 1) == 1; }
+
+    /** Spin, then sleep until other side signals
+     */
+    bool wait(Waiters &rWaiters, TryFunc pTry, T *pItem, const std::chrono::steady_clock::time_point *pDeadline)
+    {
+        for(uint32 i = 0;i < MPMC_RING_SPIN_COUNT;++i)
+        {
+            if((this->*pTry)(pItem))
+                return true;
+        }
+
+        for(;;)
+        {
+            if(m_aborted)
+                return false;
+
+            //register before last try - pairs with fence in signal()
+            rWaiters.m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            uint64 epoch;
+            {
+                std::lock_guard<std::mutex> rGuard(rWaiters.m_lock);
+                epoch = rWaiters.m_epoch;
+            }
+
+            if((this->*pTry)(pItem))
+            {
+                rWaiters.m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            bool timedOut = false;
+            {
+                std::unique_lock<std::mutex> rGuard(rWaiters.m_lock);
+                while(rWaiters.m_epoch == epoch && !m_aborted && !timedOut)
+                {
+                    if(pDeadline == NULL)
+                    {
+                        rWaiters.m_cond.wait(rGuard);
+                    }
+                    else
+                    {
+                        timedOut = (rWaiters.m_cond.wait_until(rGuard, *pDeadline) == std::cv_status::timeout);
+                    }
+                }
+            }
+            rWaiters.m_waiters.fetch_sub(1, std::memory_order_relaxed);
+
+            if(timedOut)
+                return (this->*pTry)(pItem);
+        }
+    }
+
+    /** Wakes sleepers of other side, no syscall when nobody sleeps
+     */
+    INLINE void signal(Waiters &rWaiters, size_t count)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(rWaiters.m_waiters.load(std::memory_order_relaxed) != 0)
+        {
+            std::lock_guard<std::mutex> rGuard(rWaiters.m_lock);
+            ++rWaiters.m_epoch;
+            if(count == 1)
+            {
+                rWaiters.m_cond.notify_one();
+            }
+            else
+            {
+                rWaiters.m_cond.notify_all();
+            }
+        }
+    }
+
+    INLINE void wakeAll(Waiters &rWaiters)
+    {
+        std::lock_guard<std::mutex> rGuard(rWaiters.m_lock);
+        ++rWaiters.m_epoch;
+        rWaiters.m_cond.notify_all();
+    }
+
+    //
+    INLINE size_t nextPow2(size_t x)
+    {
+        --x;
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        x |= (x >> 16) >> 16;
+        return x+1;
+    }
+
+    //producers and consumers touch different positions - keep them on own cache lines
+    char                    m_pad0[64];
+    std::atomic<size_t>     m_enqueuePos;
+    char                    m_pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t>     m_dequeuePos;
+    char                    m_pad2[64 - sizeof(std::atomic<size_t>)];
+    Cell                    *m_pCells;
+    size_t                  m_mask;
+    std::atomic<bool>       m_aborted;
+
+    Waiters                 m_rGetWaiters;
+    Waiters                 m_rPutWaiters;
+};
+
+#endif
@@ -0,0 +1,95 @@
+//
+//  MPSCQueue.h
+//
+//  Intrusive lock-free multi-producer/single-consumer queue (Dmitry Vyukov).
+//
+
+#ifndef TransDB_MPSCQueue_h
+#define TransDB_MPSCQueue_h
+
+// Queue node, queued types derive from it
+struct MPSCNode
+{
+    MPSCNode() NOEXCEPT : m_pNext(NULL)
+    {
+    }
+    
+    std::atomic<MPSCNode*>  m_pNext;
+};
+
+template <class T>
+class MPSCQueue
+{
+public:
+    explicit MPSCQueue() NOEXCEPT : m_pHead(&m_rStub), m_pTail(&m_rStub)
+    {
+    }
+    
+    /** Push node - wait-free, can be called from any thread.
+     */
+    INLINE void push(T *pNode) NOEXCEPT
+    {
+        push(static_cast<MPSCNode*>(pNode));
+    }
+    
+    /** Pop node - only from consumer thread.
+     * Can return NULL while producer is in the middle of push, producer has to signal consumer after push.
+     */
+    INLINE T *pop() NOEXCEPT
+    {
+        MPSCNode *pTail = m_pTail;
+        MPSCNode *pNext = pTail->m_pNext.load(std::memory_order_acquire);
+        if(pTail == &m_rStub)
+        {
+            if(pNext == NULL)
+                return NULL;
+            
+            m_pTail = pNext;
+            pTail = pNext;
+            pNext = pNext->m_pNext.load(std::memory_order_acquire);
+        }
+        
+        if(pNext != NULL)
+        {
+            m_pTail = pNext;
+            return static_cast<T*>(pTail);
+        }
+        
+        MPSCNode *pHead = m_pHead.load(std::memory_order_acquire);
+        if(pTail != pHead)
+            return NULL;
+        
+        push(&m_rStub);
+        pNext = pTail->m_pNext.load(std::memory_order_acquire);
+        if(pNext != NULL)
+        {
+            m_pTail = pNext;
+            return static_cast<T*>(pTail);
+        }
+        return NULL;
+    }
+    
+    /** Is queue empty - only from consumer thread.
+     */
+    INLINE bool empty() const NOEXCEPT
+    {
+        return m_pTail == &m_rStub && m_rStub.m_pNext.load(std::memory_order_acquire) == NULL;
+    }
+    
+private:
+    DISALLOW_COPY_AND_ASSIGN(MPSCQueue);
+    
+    INLINE void push(MPSCNode *pNode) NOEXCEPT
+    {
+        pNode->m_pNext.store(NULL, std::memory_order_relaxed);
+        MPSCNode *pPrev = m_pHead.exchange(pNode, std::memory_order_acq_rel);
+        pPrev->m_pNext.store(pNode, std::memory_order_release);
+    }
+    
+    //variables
+    std::atomic<MPSCNode*>  m_pHead;
+    MPSCNode                *m_pTail;
+    MPSCNode                m_rStub;
+};
+
+#endif
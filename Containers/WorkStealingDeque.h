@@ -0,0 +1,151 @@
+//
+//  WorkStealingDeque.h
+//
+//  Growable Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli - C11 memory model version).
+//
+
+#ifndef TransDB_WorkStealingDeque_h
+#define TransDB_WorkStealingDeque_h
+
+#define WORK_STEALING_DEQUE_INITIAL_SIZE    256     //power of 2
+
+template <class T>
+class WorkStealingDeque
+{
+    /** Circular array, replaced arrays are kept until destruction - thieves can still read them
+     */
+    struct Array
+    {
+        explicit Array(int64 size, Array *pPrev) : m_mask(size - 1), m_pBuffer(new std::atomic<T*>[size]), m_pPrev(pPrev)
+        {
+        }
+
+        ~Array()
+        {
+            delete [] m_pBuffer;
+        }
+
+        INLINE int64 size() const NOEXCEPT                  { return m_mask + 1; }
+        INLINE T *get(int64 i) const NOEXCEPT               { return m_pBuffer[i & m_mask].load(std::memory_order_relaxed); }
+        INLINE void put(int64 i, T *pItem) NOEXCEPT         { m_pBuffer[i & m_mask].store(pItem, std::memory_order_relaxed); }
+
+        int64               m_mask;
+        std::atomic<T*>     *m_pBuffer;
+        Array               *m_pPrev;
+    };
+
+public:
+    explicit WorkStealingDeque() : m_top(0), m_bottom(0), m_pArray(new Array(WORK_STEALING_DEQUE_INITIAL_SIZE, NULL))
+    {
+    }
+
+    ~WorkStealingDeque()
+    {
+        Array *pArray = m_pArray.load(std::memory_order_relaxed);
+        while(pArray != NULL)
+        {
+            Array *pPrev = pArray->m_pPrev;
+            delete pArray;
+            pArray = pPrev;
+        }
+    }
+
+    /** Push to bottom - only from owner thread
+     */
+    void push(T *pItem)
+    {
+        int64 bottom = m_bottom.load(std::memory_order_relaxed);
+        int64 top = m_top.load(std::memory_order_acquire);
+        Array *pArray = m_pArray.load(std::memory_order_relaxed);
+        if(bottom - top > pArray->size() - 1)
+        {
+            pArray = grow(pArray, top, bottom);
+        }
+        pArray->put(bottom, pItem);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    /** Pop from bottom (LIFO) - only from owner thread
+     */
+    T *pop() NOEXCEPT
+    {
+        int64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array *pArray = m_pArray.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 top = m_top.load(std::memory_order_relaxed);
+
+        T *pItem = NULL;
+        if(top <= bottom)
+        {
+            pItem = pArray->get(bottom);
+            if(top == bottom)
+            {
+                //last item - race with thieves
+                if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    pItem = NULL;
+                }
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return pItem;
+    }
+
+    /** Steal from top (FIFO) - any thread, returns NULL when empty or when other thief won
+     */
+    T *steal() NOEXCEPT
+    {
+        int64 top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 bottom = m_bottom.load(std::memory_order_acquire);
+
+        T *pItem = NULL;
+        if(top < bottom)
+        {
+            Array *pArray = m_pArray.load(std::memory_order_acquire);
+            pItem = pArray->get(top);
+            if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return NULL;
+            }
+        }
+        return pItem;
+    }
+
+    /** Approximate item count - any thread
+     */
+    INLINE size_t size() const NOEXCEPT
+    {
+        int64 bottom = m_bottom.load(std::memory_order_relaxed);
+        int64 top = m_top.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+
+    Array *grow(Array *pArray, int64 top, int64 bottom)
+    {
+        Array *pNewArray = new Array(pArray->size() * 2, pArray);
+        for(int64 i = top;i < bottom;++i)
+        {
+            pNewArray->put(i, pArray->get(i));
+        }
+        m_pArray.store(pNewArray, std::memory_order_release);
+        return pNewArray;
+    }
+
+    //thieves and owner touch different ends - keep them on own cache lines (padding, heap objects are not over-aligned in C++11)
+    std::atomic<int64>  m_top;
+    char                m_pad0[64 - sizeof(std::atomic<int64>)];
+    std::atomic<int64>  m_bottom;
+    char                m_pad1[64 - sizeof(std::atomic<int64>)];
+    std::atomic<Array*> m_pArray;
+};
+
+#endif
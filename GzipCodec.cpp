@@ -0,0 +1,202 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "GzipCodec.h"
+
+#define GZIP_ENCODING				16
+
+/** Prepares free space at buffer tail as zlib output
+ */
+static INLINE void GzipCodec_prepareOutput(z_stream &rStream, ByteBuffer &rBuffOut)
+{
+    size_t size = rBuffOut.size();
+    if(rBuffOut.capacity() - size < GZIP_CODEC_MIN_OUTPUT)
+    {
+        rBuffOut.reserve(std::max<size_t>(rBuffOut.capacity() * 2, size + GZIP_CODEC_MIN_OUTPUT));
+    }
+    
+    rStream.next_out = rBuffOut.storage() + size;
+    rStream.avail_out = static_cast<uInt>(std::min<size_t>(rBuffOut.capacity() - size, UINT_MAX));
+}
+
+/** Commits output written by zlib
+ */
+static INLINE void GzipCodec_commitOutput(z_stream &rStream, ByteBuffer &rBuffOut)
+{
+    rBuffOut.resize(static_cast<size_t>(rStream.next_out - rBuffOut.storage()));
+}
+
+GzipEncoder::GzipEncoder(int compressionLevel, int memLevel)
+{
+    memset(&m_stream, 0, sizeof(z_stream));
+    m_initResult = deflateInit2(&m_stream, compressionLevel, Z_DEFLATED, GZIP_ENCODING+MAX_WBITS, memLevel, Z_DEFAULT_STRATEGY);
+}
+
+GzipEncoder::~GzipEncoder()
+{
+    if(m_initResult == Z_OK)
+    {
+        deflateEnd(&m_stream);
+    }
+}
+
+int GzipEncoder::Deflate(int flush, ByteBuffer &rBuffOut)
+{
+    if(m_initResult != Z_OK)
+        return m_initResult;
+    
+    int ret;
+    do
+    {
+        GzipCodec_prepareOutput(m_stream, rBuffOut);
+        ret = deflate(&m_stream, flush);
+        GzipCodec_commitOutput(m_stream, rBuffOut);
+        
+        if(ret == Z_STREAM_ERROR)
+            return ret;
+        
+        //output space was not exhausted - all input consumed and flush done
+    }while(m_stream.avail_out == 0 && ret != Z_STREAM_END);
+    
+    return Z_OK;
+}
+
+int GzipEncoder::Feed(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut)
+{
+    m_stream.next_in = const_cast<Bytef*>(pData);
+    m_stream.avail_in = static_cast<uInt>(dataLen);
+    return Deflate(Z_NO_FLUSH, rBuffOut);
+}
+
+int GzipEncoder::Flush(ByteBuffer &rBuffOut)
+{
+    m_stream.next_in = NULL;
+    m_stream.avail_in = 0;
+    return Deflate(Z_SYNC_FLUSH, rBuffOut);
+}
+
+int GzipEncoder::Finish(ByteBuffer &rBuffOut)
+{
+    m_stream.next_in = NULL;
+    m_stream.avail_in = 0;
+    int ret = Deflate(Z_FINISH, rBuffOut);
+    Reset();
+    return ret;
+}
+
+int GzipEncoder::Compress(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut)
+{
+    //we need clean buffer
+    rBuffOut.resize(0);
+    
+    int ret = Feed(pData, dataLen, rBuffOut);
+    if(ret != Z_OK)
+    {
+        Reset();
+        return ret;
+    }
+    return Finish(rBuffOut);
+}
+
+void GzipEncoder::Reset()
+{
+    if(m_initResult == Z_OK)
+    {
+        deflateReset(&m_stream);
+    }
+}
+
+GzipDecoder::GzipDecoder()
+{
+    memset(&m_stream, 0, sizeof(z_stream));
+    m_initResult = inflateInit2(&m_stream, GZIP_ENCODING+MAX_WBITS);
+}
+
+GzipDecoder::~GzipDecoder()
+{
+    if(m_initResult == Z_OK)
+    {
+        inflateEnd(&m_stream);
+    }
+}
+
+int GzipDecoder::Feed(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut)
+{
+    if(m_initResult != Z_OK)
+        return m_initResult;
+    
+    m_stream.next_in = const_cast<Bytef*>(pData);
+    m_stream.avail_in = static_cast<uInt>(dataLen);
+    
+    int ret;
+    do
+    {
+        GzipCodec_prepareOutput(m_stream, rBuffOut);
+        ret = inflate(&m_stream, Z_NO_FLUSH);
+        GzipCodec_commitOutput(m_stream, rBuffOut);
+        
+        switch(ret)
+        {
+            case Z_STREAM_END:
+            {
+                inflateReset(&m_stream);
+                return Z_STREAM_END;
+            }
+            case Z_BUF_ERROR:
+            {
+                //no progress possible - wait for more input
+                return Z_OK;
+            }
+            case Z_NEED_DICT:
+                ret = Z_DATA_ERROR;     /* and fall through */
+            case Z_DATA_ERROR:
+            case Z_MEM_ERROR:
+            case Z_STREAM_ERROR:
+            {
+                inflateReset(&m_stream);
+                return ret;
+            }
+        }
+    }while(m_stream.avail_in != 0 || m_stream.avail_out == 0);
+    
+    return Z_OK;
+}
+
+int GzipDecoder::Decompress(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut)
+{
+    //we need clean buffer
+    rBuffOut.resize(0);
+    
+    int ret = Feed(pData, dataLen, rBuffOut);
+    if(ret == Z_STREAM_END)
+        return Z_OK;
+    
+    //truncated message
+    Reset();
+    return ret == Z_OK ? Z_DATA_ERROR : ret;
+}
+
+void GzipDecoder::Reset()
+{
+    if(m_initResult == Z_OK)
+    {
+        inflateReset(&m_stream);
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef GZIP_CODEC_H
+#define GZIP_CODEC_H
+
+#include "Defines.h"
+#include "Packets/ByteBuffer.h"
+#include "zlib/zlib.h"
+
+#ifndef GZIP_CODEC_MIN_OUTPUT
+    #define GZIP_CODEC_MIN_OUTPUT 4096      //min free space in output buffer before (de)compression step
+#endif
+
+/** Gzip compressor keeping z_stream (and its deflate window allocation) across messages.
+ * Output is written directly to tail of ByteBuffer. Return values are zlib codes.
+ */
+class GzipEncoder
+{
+public:
+    explicit GzipEncoder(int compressionLevel = Z_DEFAULT_COMPRESSION, int memLevel = MAX_MEM_LEVEL);
+    ~GzipEncoder();
+    
+    /** Compresses next part of message, appends output
+     */
+    int Feed(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut);
+    
+    /** Flushes pending output so peer can decompress all fed data (Z_SYNC_FLUSH)
+     */
+    int Flush(ByteBuffer &rBuffOut);
+    
+    /** Writes gzip trailer and resets stream for next message
+     */
+    int Finish(ByteBuffer &rBuffOut);
+    
+    /** Compresses whole message into cleared buffer
+     */
+    int Compress(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut);
+    
+    /** Drops unfinished message
+     */
+    void Reset();
+    
+    /** Z_OK if deflate was initialized
+     */
+    int GetInitResult() const   { return m_initResult; }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(GzipEncoder);
+    
+    int Deflate(int flush, ByteBuffer &rBuffOut);
+    
+    z_stream    m_stream;
+    int         m_initResult;
+};
+
+/** Gzip decompressor keeping z_stream across messages, output is written directly to tail of ByteBuffer.
+ * Return values are zlib codes.
+ */
+class GzipDecoder
+{
+public:
+    GzipDecoder();
+    ~GzipDecoder();
+    
+    /** Decompresses next part of message, appends output
+     * @return Z_OK if more input is expected, Z_STREAM_END when message is complete (stream is reset
+     *         for next message, unused input is ignored), error code otherwise
+     */
+    int Feed(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut);
+    
+    /** Decompresses whole message into cleared buffer
+     */
+    int Decompress(const uint8 *pData, size_t dataLen, ByteBuffer &rBuffOut);
+    
+    /** Drops unfinished message
+     */
+    void Reset();
+    
+    /** Z_OK if inflate was initialized
+     */
+    int GetInitResult() const   { return m_initResult; }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(GzipDecoder);
+    
+    z_stream    m_stream;
+    int         m_initResult;
+};
+
+#endif
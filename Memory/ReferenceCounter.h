@@ -28,15 +28,15 @@ public:
     
     INLINE void release()
     {
-        --m_referenceCount;
-        if(m_referenceCount == 0)
+        if(--m_referenceCount == 0)
         {
             delete this;
         }
     }
     
 private:
-    uint32  m_referenceCount;
+    //shared between threads (e.g. one packet queued on sockets of several reactors)
+    std::atomic<uint32>     m_referenceCount;
 };
 
 #endif
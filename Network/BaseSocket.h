@@ -67,6 +67,15 @@ public:
 	*/
 	virtual bool IsConnected() const = 0;
 	virtual bool IsDeleted() const = 0;
+	
+	/** Is async connect in progress? Listen socket never connects
+	 */
+	virtual bool IsConnecting() const	{ return false; }
+	
+	/** Finishes async connect on reactor event
+	 * @return true if socket is connected and event should be processed
+	 */
+	virtual bool CompleteConnect()		{ return true; }
 
 	/** Disconnects the socket
 	 */
@@ -100,11 +109,18 @@ public:
 	virtual void DecSendLock() = 0;
 	virtual bool AcquireSendLock() = 0;
     
+    /** Handle in SocketMgr socket table, 0 if socket is not registered
+     */
+    SocketHandle GetHandle() const                  { return m_handle; }
+    SocketHandle ExchangeHandle(SocketHandle handle) { return m_handle.exchange(handle); }
+    
 protected:
     //default ctor
-    BaseSocket() {}
+    BaseSocket() : m_handle(0) {}
     
 private:
+    std::atomic<SocketHandle>   m_handle;
+    
 	//disable copy constructor and assign
     DISALLOW_COPY_AND_ASSIGN(BaseSocket);
 };
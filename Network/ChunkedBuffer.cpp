@@ -0,0 +1,370 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "../Defines.h"
+#include "ChunkedBuffer.h"
+
+SocketBufferPool::SocketBufferPool(size_t maxFreeChunks) : m_freeChunks(0), m_maxFreeChunks(maxFreeChunks), m_usedChunks(0)
+{
+
+}
+
+SocketBufferPool::~SocketBufferPool()
+{
+	if(m_usedChunks != 0)
+	{
+		Log.Warning(__FUNCTION__, "Pool destroyed with %u chunks still in use.", (uint32)m_usedChunks.load());
+	}
+}
+
+SocketBufferChunk * SocketBufferPool::Allocate()
+{
+	std::lock_guard<std::mutex> rGuard(m_rLock);
+	if(m_freeChunks > 0)
+	{
+		--m_freeChunks;
+	}
+	++m_usedChunks;
+	return m_rPool.allocate(this);
+}
+
+void SocketBufferPool::Deallocate(SocketBufferChunk * pChunk)
+{
+	std::lock_guard<std::mutex> rGuard(m_rLock);
+	m_rPool.deallocate(pChunk);
+	--m_usedChunks;
+	++m_freeChunks;
+
+	//too many idle chunks - give half of them back to system
+	if(m_freeChunks > m_maxFreeChunks)
+	{
+		m_rPool.recycle();
+		m_freeChunks /= 2;
+	}
+}
+
+/** Constructor
+ */
+ChunkedBuffer::ChunkedBuffer(size_t maxSize) : m_pHead(NULL), m_pTail(NULL), m_pSpare(NULL), m_pPool(NULL), m_size(0), m_chunks(0), m_maxSize(maxSize)
+{
+
+}
+
+/** Destructor
+ */
+ChunkedBuffer::~ChunkedBuffer()
+{
+	Clear();
+}
+
+SocketBufferChunk * ChunkedBuffer::AllocateChunk()
+{
+	++m_chunks;
+	if(m_pPool != NULL)
+	{
+		return m_pPool->Allocate();
+	}
+	return new SocketBufferChunk(NULL);
+}
+
+void ChunkedBuffer::FreeChunk(SocketBufferChunk * pChunk)
+{
+	if(pChunk->m_pPool != NULL)
+	{
+		pChunk->m_pPool->Deallocate(pChunk);
+	}
+	else
+	{
+		delete pChunk;
+	}
+}
+
+bool ChunkedBuffer::AppendChunk()
+{
+	//check limit
+	if(!CanGrow())
+		return false;
+
+	SocketBufferChunk *pChunk = AllocateChunk();
+	if(m_pTail != NULL)
+	{
+		m_pTail->m_pNext = pChunk;
+	}
+	else
+	{
+		m_pHead = pChunk;
+	}
+	m_pTail = pChunk;
+	return true;
+}
+
+void ChunkedBuffer::ReleaseHead()
+{
+	SocketBufferChunk *pChunk = m_pHead;
+	m_pHead = pChunk->m_pNext;
+	if(m_pHead == NULL)
+	{
+		m_pTail = NULL;
+	}
+	--m_chunks;
+	FreeChunk(pChunk);
+}
+
+void ChunkedBuffer::ReleaseSpare()
+{
+	while(m_pSpare != NULL)
+	{
+		SocketBufferChunk *pChunk = m_pSpare;
+		m_pSpare = pChunk->m_pNext;
+		--m_chunks;
+		FreeChunk(pChunk);
+	}
+}
+
+/** Read bytes from the buffer
+ * @param destination pointer to destination where bytes will be written
+ * @param bytes number of bytes to read
+ * @return true if there was enough data, false otherwise
+ */
+bool ChunkedBuffer::Read(void * destination, size_t bytes)
+{
+	if(m_size < bytes)
+		return false;
+
+	uint8 *pDst = static_cast<uint8*>(destination);
+	size_t cnt = bytes;
+	while(cnt > 0)
+	{
+		size_t toRead = std::min(cnt, m_pHead->GetSize());
+		memcpy(pDst, m_pHead->m_data + m_pHead->m_rpos, toRead);
+		pDst += toRead;
+		cnt -= toRead;
+		Remove(toRead);
+	}
+	return true;
+}
+
+/** Write bytes to the buffer, grows buffer up to maxSize
+ * @param data pointer to the data to be written
+ * @param bytes number of bytes to be written
+ * @return true if was successful, otherwise false
+ */
+bool ChunkedBuffer::Write(const void * data, size_t bytes)
+{
+	if(m_maxSize != 0 && (m_size + bytes) > m_maxSize)
+		return false;
+
+	const uint8 *pSrc = static_cast<const uint8*>(data);
+	size_t cnt = bytes;
+	while(cnt > 0)
+	{
+		if(m_pTail == NULL || m_pTail->GetSpace() == 0)
+		{
+			if(!AppendChunk())
+				return false;
+		}
+
+		size_t toWrite = std::min(cnt, m_pTail->GetSpace());
+		memcpy(m_pTail->m_data + m_pTail->m_wpos, pSrc, toWrite);
+		m_pTail->m_wpos += toWrite;
+		m_size += toWrite;
+		pSrc += toWrite;
+		cnt -= toWrite;
+	}
+	return true;
+}
+
+/** Returns the number of contiguous bytes available at GetBuffer(), allocates chunk if needed.
+ */
+size_t ChunkedBuffer::GetSpace()
+{
+	if(m_maxSize != 0 && m_size >= m_maxSize)
+		return 0;
+
+	if(m_pTail == NULL || m_pTail->GetSpace() == 0)
+	{
+		if(!AppendChunk())
+			return 0;
+	}
+
+	size_t space = m_pTail->GetSpace();
+	if(m_maxSize != 0)
+	{
+		space = std::min(space, m_maxSize - m_size);
+	}
+	return space;
+}
+
+/** Removes len bytes from the front of the buffer
+ * @param len the number of bytes to "cut"
+ */
+void ChunkedBuffer::Remove(size_t len)
+{
+	size_t cnt = std::min(len, m_size);
+	m_size -= cnt;
+	while(m_pHead != NULL)
+	{
+		size_t toRemove = std::min(cnt, m_pHead->GetSize());
+		m_pHead->m_rpos += toRemove;
+		cnt -= toRemove;
+
+		//consumed chunk goes back to pool
+		if(m_pHead->GetSize() == 0 && (m_pHead != m_pTail || m_pHead->GetSpace() == 0 || m_size == 0))
+		{
+			ReleaseHead();
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+#ifndef WIN32
+
+/** Fills iovecs with stored data (one per chunk) for writev/sendmsg
+ * @param pVec array of iovecs
+ * @param maxCount size of pVec array
+ * @return number of filled iovecs
+ */
+size_t ChunkedBuffer::GetDataRegions(struct iovec * pVec, size_t maxCount) const
+{
+	size_t count = 0;
+	for(SocketBufferChunk *pChunk = m_pHead;pChunk != NULL && count < maxCount;pChunk = pChunk->m_pNext)
+	{
+		if(pChunk->GetSize() == 0)
+			continue;
+
+		pVec[count].iov_base = pChunk->m_data + pChunk->m_rpos;
+		pVec[count].iov_len = pChunk->GetSize();
+		++count;
+	}
+	return count;
+}
+
+/** Fills iovecs with free space of last chunk and spare chunks (up to maxSize) for readv/recvmsg.
+ * Spare chunks are linked to buffer by IncrementWrittenRegions.
+ * @param pVec array of iovecs
+ * @param maxCount size of pVec array
+ * @return number of filled iovecs
+ */
+size_t ChunkedBuffer::GetFreeRegions(struct iovec * pVec, size_t maxCount)
+{
+	if(m_maxSize != 0 && m_size >= m_maxSize)
+		return 0;
+
+	size_t limit = (m_maxSize != 0) ? (m_maxSize - m_size) : SIZE_MAX;
+	size_t count = 0;
+	size_t space;
+
+	//rest of last chunk first
+	if(maxCount != 0 && m_pTail != NULL && m_pTail->GetSpace() != 0)
+	{
+		space = std::min(m_pTail->GetSpace(), limit);
+		pVec[0].iov_base = m_pTail->m_data + m_pTail->m_wpos;
+		pVec[0].iov_len = space;
+		limit -= space;
+		++count;
+	}
+
+	//then whole chunks - kept from previous call or taken from pool
+	SocketBufferChunk **ppSpare = &m_pSpare;
+	while(count < maxCount && limit != 0)
+	{
+		if(*ppSpare == NULL)
+		{
+			if(!CanGrow())
+				break;
+
+			*ppSpare = AllocateChunk();
+		}
+
+		space = std::min<size_t>(SOCKET_BUFFER_CHUNK_SIZE, limit);
+		pVec[count].iov_base = (*ppSpare)->m_data;
+		pVec[count].iov_len = space;
+		limit -= space;
+		++count;
+		ppSpare = &(*ppSpare)->m_pNext;
+	}
+	return count;
+}
+
+#endif
+
+/** Increments the "writen" pointer forward len bytes over regions returned by GetFreeRegions,
+ * spare chunks which got no data are returned to pool
+ * @param len number of bytes to step
+ */
+void ChunkedBuffer::IncrementWrittenRegions(size_t len)
+{
+	m_size += len;
+
+	//rest of last chunk
+	if(m_pTail != NULL)
+	{
+		size_t toWrite = std::min(len, m_pTail->GetSpace());
+		m_pTail->m_wpos += toWrite;
+		len -= toWrite;
+	}
+
+	//filled spare chunks go to chain in order
+	while(len > 0)
+	{
+		SocketBufferChunk *pChunk = m_pSpare;
+		m_pSpare = pChunk->m_pNext;
+		pChunk->m_pNext = NULL;
+		pChunk->m_wpos = std::min<size_t>(len, SOCKET_BUFFER_CHUNK_SIZE);
+		len -= pChunk->m_wpos;
+
+		if(m_pTail != NULL)
+		{
+			m_pTail->m_pNext = pChunk;
+		}
+		else
+		{
+			m_pHead = pChunk;
+		}
+		m_pTail = pChunk;
+	}
+
+	ReleaseSpare();
+}
+
+/** Returns unused chunk to pool when buffer is empty (after failed read)
+ */
+void ChunkedBuffer::ReleaseIdle()
+{
+	if(m_size == 0)
+	{
+		Clear();
+	}
+}
+
+/** Returns all chunks to pool
+ */
+void ChunkedBuffer::Clear()
+{
+	while(m_pHead != NULL)
+	{
+		ReleaseHead();
+	}
+	ReleaseSpare();
+	m_size = 0;
+}
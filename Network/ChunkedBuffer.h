@@ -0,0 +1,224 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CHUNKEDBUFFER_H
+#define CHUNKEDBUFFER_H
+
+#include "../Memory/MemoryAllocator.h"
+
+#ifndef WIN32
+    #include <sys/uio.h>
+#endif
+
+#ifndef SOCKET_BUFFER_CHUNK_SIZE
+    #define SOCKET_BUFFER_CHUNK_SIZE        4096
+#endif
+#ifndef SOCKET_BUFFER_POOL_MAX_FREE
+    #define SOCKET_BUFFER_POOL_MAX_FREE     1024
+#endif
+
+class SocketBufferPool;
+
+/** Fixed size slab, chained into ChunkedBuffer
+ */
+struct SocketBufferChunk
+{
+	explicit SocketBufferChunk(SocketBufferPool * pPool) : m_pNext(NULL), m_pPool(pPool), m_rpos(0), m_wpos(0)
+	{
+	}
+
+	INLINE size_t GetSize() const		{ return m_wpos - m_rpos; }
+	INLINE size_t GetSpace() const		{ return SOCKET_BUFFER_CHUNK_SIZE - m_wpos; }
+
+	SocketBufferChunk	*m_pNext;
+	SocketBufferPool	*m_pPool;
+	size_t				m_rpos;
+	size_t				m_wpos;
+	uint8				m_data[SOCKET_BUFFER_CHUNK_SIZE];
+};
+
+/** Shared pool of chunks (one per reactor), thread safe
+ */
+class SocketBufferPool
+{
+public:
+	explicit SocketBufferPool(size_t maxFreeChunks = SOCKET_BUFFER_POOL_MAX_FREE);
+	~SocketBufferPool();
+
+	/** Returns chunk from pool or allocates new one
+	 */
+	SocketBufferChunk * Allocate();
+
+	/** Returns chunk to pool, half of free chunks is released to system when there is too many of them
+	 */
+	void Deallocate(SocketBufferChunk * pChunk);
+
+	/** Number of chunks currently used by buffers
+	 */
+	INLINE size_t GetUsedCount() const		{ return m_usedChunks; }
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(SocketBufferPool);
+
+	FixedPool<SocketBufferChunk>	m_rPool;
+	std::mutex						m_rLock;
+	size_t							m_freeChunks;
+	size_t							m_maxFreeChunks;
+	std::atomic<size_t>				m_usedChunks;
+};
+
+/** Growable buffer made of chained chunks, same interface as CircularBuffer.
+ * Empty buffer holds no chunks, chunks are taken from pool on demand up to maxSize
+ * and returned as soon as they are consumed.
+ */
+class ChunkedBuffer
+{
+public:
+	/** Constructor
+	* @param maxSize maximum number of stored bytes, 0 - unlimited
+	*/
+	explicit ChunkedBuffer(size_t maxSize);
+
+	/** Destructor
+	*/
+	~ChunkedBuffer();
+
+	/** Sets pool used for new chunks, if not set chunks are allocated from system
+	*/
+	INLINE void SetPool(SocketBufferPool * pPool)		{ m_pPool = pPool; }
+
+	/** Read bytes from the buffer
+	* @param destination pointer to destination where bytes will be written
+	* @param bytes number of bytes to read
+	* @return true if there was enough data, false otherwise
+	*/
+	bool Read(void * destination, size_t bytes);
+
+	/** Write bytes to the buffer, grows buffer up to maxSize
+	* @param data pointer to the data to be written
+	* @param bytes number of bytes to be written
+	* @return true if was successful, otherwise false
+	*/
+	bool Write(const void * data, size_t bytes);
+
+	/** Returns the number of contiguous bytes available at GetBuffer(), allocates chunk if needed.
+	*/
+	size_t GetSpace();
+
+	/** Returns the number of bytes currently stored in the buffer.
+	*/
+	INLINE size_t GetSize() const						{ return m_size; }
+
+	/** Returns the number of contiguous bytes (that can be pushed out in one operation)
+	*/
+	INLINE size_t GetContiguiousBytes() const			{ return (m_pHead != NULL) ? m_pHead->GetSize() : 0; }
+
+	/** Removes len bytes from the front of the buffer
+	* @param len the number of bytes to "cut"
+	*/
+	void Remove(size_t len);
+
+	/** Returns a pointer at the "end" of the buffer, where new data can be written, call GetSpace() first
+	*/
+	INLINE void * GetBuffer() const					{ return (m_pTail != NULL) ? m_pTail->m_data + m_pTail->m_wpos : NULL; }
+
+	/** Increments the "writen" pointer forward len bytes
+	* @param len number of bytes to step
+	*/
+	INLINE void IncrementWritten(size_t len)
+	{
+		m_pTail->m_wpos += len;
+		m_size += len;
+	}
+
+	/** Returns a pointer at the "beginning" of the buffer, where data can be pulled from
+	*/
+	INLINE void * GetBufferStart() const				{ return (m_pHead != NULL) ? m_pHead->m_data + m_pHead->m_rpos : NULL; }
+
+#ifndef WIN32
+	/** Fills iovecs with stored data (one per chunk) for writev/sendmsg
+	* @param pVec array of iovecs
+	* @param maxCount size of pVec array
+	* @return number of filled iovecs
+	*/
+	size_t GetDataRegions(struct iovec * pVec, size_t maxCount) const;
+
+	/** Fills iovecs with free space of last chunk and spare chunks (up to maxSize) for readv/recvmsg.
+	* Spare chunks are linked to buffer by IncrementWrittenRegions.
+	* @param pVec array of iovecs
+	* @param maxCount size of pVec array
+	* @return number of filled iovecs
+	*/
+	size_t GetFreeRegions(struct iovec * pVec, size_t maxCount);
+#endif
+
+	/** Increments the "writen" pointer forward len bytes over regions returned by GetFreeRegions,
+	* spare chunks which got no data are returned to pool
+	* @param len number of bytes to step
+	*/
+	void IncrementWrittenRegions(size_t len);
+
+	/** Returns unused chunk to pool when buffer is empty (after failed read)
+	*/
+	void ReleaseIdle();
+
+	/** Returns all chunks to pool
+	*/
+	void Clear();
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(ChunkedBuffer);
+
+	/** Limit of owned chunks (chain and spare) allows one more chunk
+	*/
+	INLINE bool CanGrow() const		{ return m_maxSize == 0 || (m_chunks * SOCKET_BUFFER_CHUNK_SIZE) < (m_maxSize + SOCKET_BUFFER_CHUNK_SIZE); }
+
+	/** Takes chunk from pool (or system)
+	*/
+	SocketBufferChunk * AllocateChunk();
+
+	/** Returns chunk to pool (or system)
+	*/
+	static void FreeChunk(SocketBufferChunk * pChunk);
+
+	/** Appends new chunk to the end of chain
+	*/
+	bool AppendChunk();
+
+	/** Removes first chunk from chain and returns it to pool
+	*/
+	void ReleaseHead();
+
+	/** Returns spare chunks to pool
+	*/
+	void ReleaseSpare();
+
+	SocketBufferChunk	*m_pHead;
+	SocketBufferChunk	*m_pTail;
+	SocketBufferChunk	*m_pSpare;		//chunks handed out by GetFreeRegions, not linked yet
+	SocketBufferPool	*m_pPool;
+	size_t				m_size;
+	size_t				m_chunks;
+	size_t				m_maxSize;
+};
+
+#endif
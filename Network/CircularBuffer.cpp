@@ -222,3 +222,97 @@ void CircularBuffer::Remove(size_t len)
 		}
 	}
 }
+
+#ifndef WIN32
+
+/** Fills iovecs with stored data (region A then region B) for writev/sendmsg
+ * @param pVec array of iovecs
+ * @param maxCount size of pVec array
+ * @return number of filled iovecs (0-2)
+ */
+size_t CircularBuffer::GetDataRegions(struct iovec * pVec, size_t maxCount) const
+{
+	size_t count = 0;
+	if(m_regionASize > 0 && count < maxCount)
+	{
+		pVec[count].iov_base = m_regionAPointer;
+		pVec[count].iov_len = m_regionASize;
+		++count;
+	}
+
+	if(m_regionBSize > 0 && count < maxCount)
+	{
+		pVec[count].iov_base = m_regionBPointer;
+		pVec[count].iov_len = m_regionBSize;
+		++count;
+	}
+
+	return count;
+}
+
+/** Fills iovecs with free space where new data can be written for readv/recvmsg
+ * @param pVec array of iovecs
+ * @param maxCount size of pVec array
+ * @return number of filled iovecs (0-2)
+ */
+size_t CircularBuffer::GetFreeRegions(struct iovec * pVec, size_t maxCount) const
+{
+	size_t count = 0;
+
+	// B exists - only space between B and A is free
+	if(m_regionBPointer != NULL)
+	{
+		if(GetBFreeSpace() > 0 && count < maxCount)
+		{
+			pVec[count].iov_base = m_regionBPointer + m_regionBSize;
+			pVec[count].iov_len = GetBFreeSpace();
+			++count;
+		}
+		return count;
+	}
+
+	// space after A, then space before A which will become region B
+	if(GetAFreeSpace() > 0 && count < maxCount)
+	{
+		pVec[count].iov_base = m_regionAPointer + m_regionASize;
+		pVec[count].iov_len = GetAFreeSpace();
+		++count;
+	}
+
+	if(GetSpaceBeforeA() > 0 && count < maxCount)
+	{
+		pVec[count].iov_base = m_buffer;
+		pVec[count].iov_len = GetSpaceBeforeA();
+		++count;
+	}
+
+	return count;
+}
+
+#endif
+
+/** Increments the "writen" pointer forward len bytes, data can span both free regions
+ * returned by GetFreeRegions
+ * @param len number of bytes to step
+ */
+void CircularBuffer::IncrementWrittenRegions(size_t len)
+{
+	if(m_regionBPointer != NULL)
+	{
+		m_regionBSize += len;
+		return;
+	}
+
+	size_t aFree = GetAFreeSpace();
+	if(len <= aFree)
+	{
+		m_regionASize += len;
+	}
+	else
+	{
+		// filled A up to the end, rest was written to start of the buffer
+		m_regionASize += aFree;
+		AllocateB();
+		m_regionBSize = len - aFree;
+	}
+}
@@ -21,6 +21,10 @@
 #ifndef CIRCULARBUFFER_H
 #define CIRCULARBUFFER_H
 
+#ifndef WIN32
+    #include <sys/uio.h>
+#endif
+
 class CircularBuffer
 {
 private:
@@ -137,6 +141,28 @@ public:
 		else
 			return m_regionBPointer;
 	}
+
+#ifndef WIN32
+	/** Fills iovecs with stored data (region A then region B) for writev/sendmsg
+	* @param pVec array of iovecs
+	* @param maxCount size of pVec array
+	* @return number of filled iovecs (0-2)
+	*/
+	size_t GetDataRegions(struct iovec * pVec, size_t maxCount) const;
+
+	/** Fills iovecs with free space where new data can be written for readv/recvmsg
+	* @param pVec array of iovecs
+	* @param maxCount size of pVec array
+	* @return number of filled iovecs (0-2)
+	*/
+	size_t GetFreeRegions(struct iovec * pVec, size_t maxCount) const;
+#endif
+
+	/** Increments the "writen" pointer forward len bytes, data can span both free regions
+	* returned by GetFreeRegions
+	* @param len number of bytes to step
+	*/
+	void IncrementWrittenRegions(size_t len);
 };
 
 #endif		// _NETLIB_CIRCULARBUFFER_H
@@ -0,0 +1,391 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+static const char * GetStatusText(uint16 status)
+{
+    switch(status)
+    {
+        case 200:   return "OK";
+        case 201:   return "Created";
+        case 202:   return "Accepted";
+        case 204:   return "No Content";
+        case 301:   return "Moved Permanently";
+        case 302:   return "Found";
+        case 304:   return "Not Modified";
+        case 400:   return "Bad Request";
+        case 401:   return "Unauthorized";
+        case 403:   return "Forbidden";
+        case 404:   return "Not Found";
+        case 405:   return "Method Not Allowed";
+        case 413:   return "Payload Too Large";
+        case 431:   return "Request Header Fields Too Large";
+        case 500:   return "Internal Server Error";
+        case 503:   return "Service Unavailable";
+        default:    return "Unknown";
+    }
+}
+
+bool HttpStringRef::EqualsNoCase(const char * pStr) const
+{
+    size_t i;
+    for(i = 0;i < m_length;++i)
+    {
+        if(pStr[i] == 0 || tolower(static_cast<uint8>(m_pData[i])) != tolower(static_cast<uint8>(pStr[i])))
+            return false;
+    }
+    return pStr[i] == 0;
+}
+
+const HttpStringRef * HttpRequest::FindHeader(const char * pName) const
+{
+    for(size_t i = 0;i < m_headerCount;++i)
+    {
+        if(m_rHeaders[i].m_name.EqualsNoCase(pName))
+            return &m_rHeaders[i].m_value;
+    }
+    return NULL;
+}
+
+int HttpSocket_on_url(http_parser * pParser, const char * at, size_t length)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    pSocket->m_rRequest.m_url.m_pData = at;
+    pSocket->m_rRequest.m_url.m_length = length;
+    return 0;
+}
+
+int HttpSocket_on_header_field(http_parser * pParser, const char * at, size_t length)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    HttpRequest & rRequest = pSocket->m_rRequest;
+    
+    //headers over limit are dropped together with their values
+    if(pSocket->m_lastWasValue || rRequest.m_headerCount == 0)
+    {
+        pSocket->m_lastWasValue = false;
+        pSocket->m_droppingHeader = (rRequest.m_headerCount == HTTP_SOCKET_MAX_HEADERS);
+        if(!pSocket->m_droppingHeader)
+        {
+            ++rRequest.m_headerCount;
+            rRequest.m_rHeaders[rRequest.m_headerCount - 1] = HttpHeader();
+        }
+    }
+    
+    if(pSocket->m_droppingHeader)
+        return 0;
+    
+    HttpStringRef & rName = rRequest.m_rHeaders[rRequest.m_headerCount - 1].m_name;
+    rName.m_pData = at;
+    rName.m_length = length;
+    return 0;
+}
+
+int HttpSocket_on_header_value(http_parser * pParser, const char * at, size_t length)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    HttpRequest & rRequest = pSocket->m_rRequest;
+    
+    pSocket->m_lastWasValue = true;
+    if(rRequest.m_headerCount == 0 || pSocket->m_droppingHeader)
+        return 0;
+    
+    HttpStringRef & rValue = rRequest.m_rHeaders[rRequest.m_headerCount - 1].m_value;
+    rValue.m_pData = at;
+    rValue.m_length = length;
+    return 0;
+}
+
+int HttpSocket_on_headers_complete(http_parser * pParser)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    HttpRequest & rRequest = pSocket->m_rRequest;
+    
+    rRequest.m_method = static_cast<http_method>(pParser->method);
+    rRequest.m_versionMajor = pParser->http_major;
+    rRequest.m_versionMinor = pParser->http_minor;
+    rRequest.m_chunked = (pParser->flags & F_CHUNKED) != 0;
+    rRequest.m_contentLength = (pParser->content_length != ULLONG_MAX) ? pParser->content_length : 0;
+    rRequest.m_keepAlive = http_should_keep_alive(pParser) != 0;
+    
+    pSocket->OnRequest(rRequest);
+    return 0;
+}
+
+int HttpSocket_on_body(http_parser * pParser, const char * at, size_t length)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    pSocket->OnRequestBody(at, length);
+    return 0;
+}
+
+int HttpSocket_on_message_complete(http_parser * pParser)
+{
+    HttpSocket *pSocket = static_cast<HttpSocket*>(pParser->data);
+    pSocket->m_messageComplete = true;
+    pSocket->OnRequestComplete();
+    
+    //stop at message boundary, next pipelined request starts with new header block
+    http_parser_pause(pParser, 1);
+    return 0;
+}
+
+HttpSocket::HttpSocket(SOCKET fd, size_t readbuffersize, size_t writebuffersize) : Socket(fd, readbuffersize, writebuffersize), m_closing(false)
+{
+    memset(&m_rSettings, 0, sizeof(http_parser_settings));
+    m_rSettings.on_url = &HttpSocket_on_url;
+    m_rSettings.on_header_field = &HttpSocket_on_header_field;
+    m_rSettings.on_header_value = &HttpSocket_on_header_value;
+    m_rSettings.on_headers_complete = &HttpSocket_on_headers_complete;
+    m_rSettings.on_body = &HttpSocket_on_body;
+    m_rSettings.on_message_complete = &HttpSocket_on_message_complete;
+    
+    ResetRequest();
+}
+
+HttpSocket::~HttpSocket()
+{
+
+}
+
+void HttpSocket::ResetRequest()
+{
+    http_parser_init(&m_rParser, HTTP_REQUEST);
+    m_rParser.data = this;
+    
+    m_rRequest.m_method = HTTP_GET;
+    m_rRequest.m_versionMajor = 1;
+    m_rRequest.m_versionMinor = 1;
+    m_rRequest.m_url = HttpStringRef();
+    m_rRequest.m_headerCount = 0;
+    m_rRequest.m_contentLength = 0;
+    m_rRequest.m_chunked = false;
+    m_rRequest.m_keepAlive = true;
+    
+    m_inBody = false;
+    m_messageComplete = false;
+    m_lastWasValue = false;
+    m_droppingHeader = false;
+    m_scanned = 0;
+    m_newLines = 0;
+    m_rHeaderCopy.clear();
+}
+
+void HttpSocket::OnRequestBody(const char * /*pData*/, size_t /*length*/)
+{
+
+}
+
+void HttpSocket::OnConnect()
+{
+    m_closing = false;
+    ResetRequest();
+}
+
+void HttpSocket::OnDisconnect()
+{
+
+}
+
+void HttpSocket::OnRead()
+{
+    ProcessRequests(GetReadBuffer());
+}
+
+template<class TBuffer>
+bool HttpSocket::ScanHeaders(TBuffer & rBuffer, const char *& pHeaders, size_t & headersSize)
+{
+    for(;;)
+    {
+        const char *pData = static_cast<const char*>(rBuffer.GetBufferStart());
+        size_t size = rBuffer.GetContiguiousBytes();
+        
+        //end of headers is empty line, \r is optional
+        size_t end = 0;
+        for(size_t i = m_scanned;i < size;++i)
+        {
+            if(pData[i] == '\n')
+            {
+                if(++m_newLines == 2)
+                {
+                    end = i + 1;
+                    break;
+                }
+            }
+            else if(pData[i] != '\r')
+            {
+                m_newLines = 0;
+            }
+        }
+        
+        if(m_rHeaderCopy.size() + (end != 0 ? end : size) > HTTP_SOCKET_MAX_HEADER_SIZE)
+        {
+            SendError(431);
+            return false;
+        }
+        
+        if(end != 0)
+        {
+            m_scanned = 0;
+            if(m_rHeaderCopy.empty())
+            {
+                //in place, caller removes headers from buffer
+                pHeaders = pData;
+                headersSize = end;
+            }
+            else
+            {
+                m_rHeaderCopy.insert(m_rHeaderCopy.end(), pData, pData + end);
+                rBuffer.Remove(end);
+                pHeaders = &m_rHeaderCopy[0];
+                headersSize = m_rHeaderCopy.size();
+            }
+            return true;
+        }
+        
+        //headers continue in next region or they fill whole buffer - copy them out
+        if(size != 0 && (size < rBuffer.GetSize() || rBuffer.GetSpace() == 0))
+        {
+            m_rHeaderCopy.insert(m_rHeaderCopy.end(), pData, pData + size);
+            rBuffer.Remove(size);
+            m_scanned = 0;
+            continue;
+        }
+        
+        m_scanned = size;
+        return false;
+    }
+}
+
+template<class TBuffer>
+void HttpSocket::ProcessRequests(TBuffer & rBuffer)
+{
+    while(rBuffer.GetSize() != 0)
+    {
+        //ignore rest of input
+        if(m_closing)
+        {
+            rBuffer.Remove(rBuffer.GetSize());
+            break;
+        }
+        
+        if(!m_inBody)
+        {
+            const char *pHeaders;
+            size_t headersSize;
+            if(!ScanHeaders(rBuffer, pHeaders, headersSize))
+            {
+                if(m_closing)
+                    continue;
+                break;
+            }
+            
+            bool inPlace = m_rHeaderCopy.empty();
+            size_t parsed = http_parser_execute(&m_rParser, &m_rSettings, pHeaders, headersSize);
+            if(inPlace)
+            {
+                rBuffer.Remove(headersSize);
+            }
+            
+            http_errno error = HTTP_PARSER_ERRNO(&m_rParser);
+            if((error != HPE_OK && error != HPE_PAUSED) || parsed != headersSize)
+            {
+                Log.Debug(__FUNCTION__, "Invalid request from %s: %s", GetRemoteIP().c_str(), http_errno_name(error));
+                SendError(400);
+                continue;
+            }
+            
+            m_rHeaderCopy.clear();
+            m_inBody = !m_messageComplete;
+        }
+        else
+        {
+            //stream body region by region
+            const char *pData = static_cast<const char*>(rBuffer.GetBufferStart());
+            size_t size = rBuffer.GetContiguiousBytes();
+            size_t parsed = http_parser_execute(&m_rParser, &m_rSettings, pData, size);
+            rBuffer.Remove(parsed);
+            
+            http_errno error = HTTP_PARSER_ERRNO(&m_rParser);
+            if(error != HPE_OK && error != HPE_PAUSED)
+            {
+                Log.Debug(__FUNCTION__, "Invalid request body from %s: %s", GetRemoteIP().c_str(), http_errno_name(error));
+                SendError(400);
+                continue;
+            }
+        }
+        
+        if(m_messageComplete)
+        {
+            //peer did not ask for keep-alive - response has Connection: close, close after it is sent
+            if(!m_rRequest.m_keepAlive)
+            {
+                m_closing = true;
+                DisconnectAfterSend();
+            }
+            ResetRequest();
+        }
+    }
+}
+
+void HttpSocket::SendError(uint16 status)
+{
+    m_rRequest.m_keepAlive = false;
+    m_closing = true;
+    
+    const char *pStatusText = GetStatusText(status);
+    SendResponse(status, "text/plain", pStatusText, strlen(pStatusText));
+    DisconnectAfterSend();
+}
+
+void HttpSocket::SendResponse(uint16 status, const char * pContentType, const void * pBody, size_t bodySize, const char * pHeaders)
+{
+    //status line and length are bounded, content type and additional headers are not
+    ByteBuffer rHeader(512);
+    char rLine[128];
+    int lineSize = snprintf(rLine, sizeof(rLine), "HTTP/1.1 %u %s\r\nContent-Type: ", status, GetStatusText(status));
+    rHeader.append(rLine, lineSize);
+    rHeader.append(pContentType, strlen(pContentType));
+    lineSize = snprintf(rLine, sizeof(rLine), "\r\nContent-Length: %u\r\n%s",
+                        static_cast<uint32>(bodySize),
+                        m_rRequest.m_keepAlive ? "" : "Connection: close\r\n");
+    rHeader.append(rLine, lineSize);
+    if(pHeaders != NULL)
+    {
+        rHeader.append(pHeaders, strlen(pHeaders));
+    }
+    rHeader.append("\r\n", 2);
+    
+    BurstBegin();
+    bool result = BurstSend(rHeader.contents(), rHeader.size()) && (bodySize == 0 || BurstSend(pBody, bodySize));
+    if(result)
+    {
+        BurstPush();
+    }
+    BurstEnd();
+    
+    if(!result)
+    {
+        Log.Warning(__FUNCTION__, "Write buffer of %s is full, response was dropped", GetRemoteIP().c_str());
+        m_closing = true;       //pipelined requests are not processed anymore
+        Disconnect();
+    }
+}
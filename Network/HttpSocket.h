@@ -0,0 +1,153 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef HTTP_SOCKET_H
+#define HTTP_SOCKET_H
+
+#include "../Packets/http_parser.h"
+
+#ifndef HTTP_SOCKET_BUFFER_SIZE
+    #define HTTP_SOCKET_BUFFER_SIZE 65536
+#endif
+#ifndef HTTP_SOCKET_MAX_HEADER_SIZE
+    #define HTTP_SOCKET_MAX_HEADER_SIZE 8192   //request line + headers, larger request is refused with 431
+#endif
+#ifndef HTTP_SOCKET_MAX_HEADERS
+    #define HTTP_SOCKET_MAX_HEADERS 32
+#endif
+
+/** Non-owning view of string inside read buffer
+ */
+struct HttpStringRef
+{
+    HttpStringRef() : m_pData(NULL), m_length(0) {}
+    
+    /** Case insensitive compare with zero terminated string
+     */
+    bool EqualsNoCase(const char * pStr) const;
+    
+    std::string ToString() const    { return std::string(m_pData, m_length); }
+    
+    const char  *m_pData;
+    size_t      m_length;
+};
+
+struct HttpHeader
+{
+    HttpStringRef   m_name;
+    HttpStringRef   m_value;
+};
+
+/** Parsed request line and headers - strings point to read buffer and are valid only inside OnRequest
+ */
+struct HttpRequest
+{
+    /** Returns header value or NULL
+     */
+    const HttpStringRef * FindHeader(const char * pName) const;
+    
+    http_method     m_method;
+    uint16          m_versionMajor;
+    uint16          m_versionMinor;
+    HttpStringRef   m_url;
+    HttpHeader      m_rHeaders[HTTP_SOCKET_MAX_HEADERS];
+    size_t          m_headerCount;
+    uint64          m_contentLength;    //0 if Content-Length is missing
+    bool            m_chunked;
+    bool            m_keepAlive;
+};
+
+/** HTTP/1.1 server connection - keep-alive and pipelining, headers are parsed without allocation
+ * when they are contiguous in read buffer, body (including chunked) is streamed to OnRequestBody.
+ * Requests are processed one by one in order, response must be sent before OnRequestComplete returns
+ * so pipelined responses keep order.
+ */
+class HttpSocket : public Socket
+{
+public:
+    explicit HttpSocket(SOCKET fd, size_t readbuffersize = HTTP_SOCKET_BUFFER_SIZE, size_t writebuffersize = HTTP_SOCKET_BUFFER_SIZE);
+    virtual ~HttpSocket();
+    
+    /** Request line and headers are parsed
+     */
+    virtual void OnRequest(const HttpRequest & rRequest) = 0;
+    
+    /** Part of request body, chunked encoding is already removed
+     */
+    virtual void OnRequestBody(const char * pData, size_t length);
+    
+    /** Whole request is received - send response
+     */
+    virtual void OnRequestComplete() = 0;
+    
+    /** Sends response with Content-Length, adds Connection: close if request was not keep-alive
+     * @param pHeaders additional headers, each terminated by \r\n, can be NULL
+     */
+    void SendResponse(uint16 status, const char * pContentType, const void * pBody, size_t bodySize, const char * pHeaders = NULL);
+    
+    //Socket
+    void OnRead();
+    void OnConnect();
+    void OnDisconnect();
+    
+private:
+    //http_parser callbacks
+    friend int HttpSocket_on_url(http_parser * pParser, const char * at, size_t length);
+    friend int HttpSocket_on_header_field(http_parser * pParser, const char * at, size_t length);
+    friend int HttpSocket_on_header_value(http_parser * pParser, const char * at, size_t length);
+    friend int HttpSocket_on_headers_complete(http_parser * pParser);
+    friend int HttpSocket_on_body(http_parser * pParser, const char * at, size_t length);
+    friend int HttpSocket_on_message_complete(http_parser * pParser);
+    
+    /** Parses requests from read buffer
+     */
+    template<class TBuffer>
+    void ProcessRequests(TBuffer & rBuffer);
+    
+    /** Looks for end of headers, copies headers out only if they are not contiguous
+     * @return true if whole header block is available at pHeaders
+     */
+    template<class TBuffer>
+    bool ScanHeaders(TBuffer & rBuffer, const char *& pHeaders, size_t & headersSize);
+    
+    /** Starts parsing of new request
+     */
+    void ResetRequest();
+    
+    /** Sends error response, stops processing of connection and closes it after response is sent
+     */
+    void SendError(uint16 status);
+    
+    http_parser             m_rParser;
+    http_parser_settings    m_rSettings;
+    HttpRequest             m_rRequest;
+    
+    bool                    m_inBody;
+    bool                    m_messageComplete;
+    bool                    m_closing;          //error or Connection: close - rest of input is ignored until disconnect
+    bool                    m_lastWasValue;     //header parser state
+    bool                    m_droppingHeader;   //header over HTTP_SOCKET_MAX_HEADERS, its value is skipped
+    
+    size_t                  m_scanned;          //header bytes at buffer start already searched for end
+    uint32                  m_newLines;         //new lines in row at end of scanned data
+    std::vector<char>       m_rHeaderCopy;      //headers split across buffer regions
+};
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LISTEN_SOCKET_URING_H
+#define LISTEN_SOCKET_URING_H
+
+#ifdef CONFIG_USE_IO_URING
+
+/** Listen socket driven by multishot accept, completions are dispatched by SocketMgr
+ */
+class ListenSocketBase
+{
+public:
+	virtual ~ListenSocketBase() {}
+
+	/** Called by worker thread for every accepted connection
+	 */
+	virtual void OnAccept(SOCKET fd) = 0;
+
+	SOCKET GetFd() const					{ return m_fd; }
+	bool IsOpen() const						{ return m_opened; }
+	UringOperation & GetAcceptEvent()		{ return m_acceptEvent; }
+
+protected:
+	ListenSocketBase() : m_fd(SocketOps::CreateTCPFileDescriptor()), m_opened(false), m_acceptEvent(SOCKET_IO_EVENT_ACCEPT, this)
+	{
+	}
+
+	SOCKET				m_fd;
+	std::atomic<bool>	m_opened;
+	UringOperation		m_acceptEvent;
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(ListenSocketBase);
+};
+
+template<class T>
+class ListenSocket : public ListenSocketBase
+{
+public:
+	/** Constructor, object must live until socket manager is shut down (accept can be in flight)
+	 */
+	explicit ListenSocket(const char * hostname, u_short port)
+	{
+		if(m_fd < 0)
+		{
+		 	Log.Error(__FUNCTION__, "ListenSocket constructor: could not create socket() %u (%s)", errno, strerror(errno));
+			throw std::runtime_error("could not create socket()");
+		}
+
+		//socket settings - io_uring does not block on blocking socket
+		SocketOps::ReuseAddr(m_fd);
+		SocketOps::Blocking(m_fd);
+
+        //create sock address struct
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(sockaddr_in));
+
+        //DNS -> IP
+		if(!strcmp(hostname, "0.0.0.0"))
+		{
+			address.sin_addr.s_addr = htonl(INADDR_ANY);
+		}
+		else
+		{
+			hostent * h = gethostbyname(hostname);
+			if(!h)
+			{
+				Log.Error(__FUNCTION__, "Could not resolve listen address");
+				throw std::runtime_error("Could not resolve listen address");
+			}
+			memcpy(&address.sin_addr, h->h_addr_list[0], sizeof(in_addr));
+		}
+
+		address.sin_family = AF_INET;
+		address.sin_port = ntohs(port);
+
+        //bind
+		if(::bind(m_fd, (const sockaddr*)&address, sizeof(sockaddr_in)) < 0)
+		{
+			Log.Error(__FUNCTION__, "Bind unsuccessful on port %u.", port);
+			throw std::runtime_error("Could not bind");
+		}
+
+        //listen
+		if(::listen(m_fd, SOMAXCONN) < 0)
+		{
+			Log.Error(__FUNCTION__, "Unable to listen on port %u.", port);
+			throw std::runtime_error("Could not listen");
+		}
+
+        //set variables
+		m_opened = true;
+
+		// arm multishot accept
+		sSocketMgr.AddListenSocket(this);
+	}
+
+	~ListenSocket()
+	{
+		Close();
+	}
+
+	void OnAccept(SOCKET fd)
+	{
+		struct sockaddr_in newPeer;
+		socklen_t newPeerLen = sizeof(sockaddr_in);
+		memset(&newPeer, 0, sizeof(sockaddr_in));
+		getpeername(fd, (sockaddr*)&newPeer, &newPeerLen);
+
+		T * s = new T(fd);
+		s->Accept(&newPeer);
+	}
+
+	/** Stops accepting, pending accept is finished by shutdown
+	 */
+	void Close()
+	{
+		// prevent a race condition here.
+		if(m_opened.exchange(false))
+		{
+			SocketOps::CloseSocket(m_fd);
+		}
+	}
+};
+
+#endif
+#endif
@@ -24,7 +24,18 @@ template<class T>
 class ListenSocket : public BaseSocket
 {
 public:
-	explicit ListenSocket(const char * hostname, u_short port) : m_fd(SocketOps::CreateTCPFileDescriptor()), m_deleted(false), m_connected(false)
+	/** Constructor
+	 * @param reusePort sets SO_REUSEPORT, more listen sockets can be bound to same port
+	 * @param deferAcceptTimeout sets TCP_DEFER_ACCEPT (seconds), 0 - disabled
+	 * @param pReactor (epoll) reactor for listen socket and accepted sockets, NULL - round robin
+	 */
+#ifdef CONFIG_USE_EPOLL
+	explicit ListenSocket(const char * hostname, u_short port, bool reusePort = false, uint32 deferAcceptTimeout = 0, SocketReactor * pReactor = NULL)
+		: m_fd(SocketOps::CreateTCPFileDescriptor()), m_deleted(false), m_connected(false), m_pReactor(pReactor)
+#else
+	explicit ListenSocket(const char * hostname, u_short port, bool reusePort = false, uint32 deferAcceptTimeout = 0)
+		: m_fd(SocketOps::CreateTCPFileDescriptor()), m_deleted(false), m_connected(false)
+#endif
 	{
 		if(m_fd < 0)
 		{
@@ -34,8 +45,23 @@ public:
         
 		//socket settings
 		SocketOps::ReuseAddr(m_fd);
+#ifdef __linux__
+		//accept4 is called in loop until EAGAIN
+		SocketOps::Nonblocking(m_fd);
+#else
 		SocketOps::Blocking(m_fd);
+#endif
 		SocketOps::SetTimeout(m_fd, 60);
+		
+		if(reusePort && !SocketOps::ReusePort(m_fd))
+		{
+			Log.Warning(__FUNCTION__, "Could not set SO_REUSEPORT on port %u.", port);
+		}
+		
+		if(deferAcceptTimeout != 0 && !SocketOps::DeferAccept(m_fd, deferAcceptTimeout))
+		{
+			Log.Warning(__FUNCTION__, "Could not set TCP_DEFER_ACCEPT on port %u.", port);
+		}
         
         //create sock address struct
         struct sockaddr_in address;
@@ -79,7 +105,11 @@ public:
 		m_deleted	= false;
 		
 		// add to mgr
+#ifdef CONFIG_USE_EPOLL
+		sSocketMgr.AddSocket(this, true, m_pReactor);
+#else
 		sSocketMgr.AddSocket(this, true);
+#endif
 	}
 
 	~ListenSocket()
@@ -97,13 +127,34 @@ public:
         struct sockaddr_in newPeer;
         socklen_t newPeerLen = sizeof(sockaddr_in);
         
+#ifdef __linux__
+        //accept whole backlog at once, new fd is already non-blocking
+        for(;;)
+        {
+            newPeerLen = sizeof(sockaddr_in);
+            newFd = ::accept4(m_fd, (sockaddr*)&newPeer, &newPeerLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(newFd < 0)
+            {
+                if(errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                
+                if(errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    Log.Error(__FUNCTION__, "accept4 failed on fd %u, errno %u (%s)", m_fd, errno, strerror(errno));
+                }
+                break;
+            }
+            
+            OnAccept(newFd, &newPeer);
+        }
+#else
         //accept new socket
 		newFd = ::accept(m_fd, (sockaddr*)&newPeer, &newPeerLen);
 		if(newFd > 0)
 		{
-			T * s = new T(newFd);
-			s->Accept(&newPeer);
+			OnAccept(newFd, &newPeer);
 		}
+#endif
 	}
 
 	void OnError(int errcode) {}
@@ -152,6 +203,21 @@ public:
 	SOCKET GetFd() const        { return m_fd; }
     
 private:
+	/** Creates socket for accepted connection
+	 */
+	void OnAccept(SOCKET newFd, const sockaddr_in * pPeer)
+	{
+		T * s = new T(newFd);
+#ifdef CONFIG_USE_EPOLL
+		//keep accepted socket on reactor of this listener
+		if(m_pReactor != NULL)
+		{
+			s->SetReactor(m_pReactor);
+		}
+#endif
+		s->Accept(pPeer);
+	}
+	
 	/** This socket's file descriptor
 	 */
 	SOCKET              m_fd;
@@ -160,7 +226,27 @@ private:
 	 */
     std::atomic<bool>	m_deleted;
 	std::atomic<bool>   m_connected;
+	
+#ifdef CONFIG_USE_EPOLL
+	/** Reactor of listen socket (SO_REUSEPORT sharding), NULL - round robin
+	 */
+	SocketReactor       *m_pReactor;
+#endif
 };
 
+#ifdef CONFIG_USE_EPOLL
+/** Opens one SO_REUSEPORT listen socket per reactor, kernel spreads connections between them
+ * and accepted sockets stay on reactor of their listener.
+ */
+template<class T>
+static void CreateReusePortListenSockets(const char * hostname, u_short port, std::vector<ListenSocket<T>*> & rListenSockets, uint32 deferAcceptTimeout = 0)
+{
+	for(uint32 i = 0;i < sSocketMgr.GetReactorCount();++i)
+	{
+		rListenSockets.push_back(new ListenSocket<T>(hostname, port, true, deferAcceptTimeout, sSocketMgr.GetReactor(i)));
+	}
+}
+#endif
+
 #endif
 
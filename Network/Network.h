@@ -22,9 +22,17 @@
 #define NETWORK_H
 
 #include "../Logs/Log.h"
+#include "../Packets/SharedByteBuffer.h"
+#include "../Containers/MPSCQueue.h"
 #include "CircularBuffer.h"
+#include "ChunkedBuffer.h"
+#include "TimerWheel.h"
+#include "SocketMetrics.h"
 #include "SocketDefines.h"
 #include "SocketOps.h"
+#include "SocketTable.h"
+#include "PacketDecoder.h"
+#include "SocketCompression.h"
 
 #ifdef CONFIG_USE_IOCP
 	#include "BaseSocket.h"
@@ -51,6 +59,13 @@
 	#include "ListenSocketLinux.h"
 #endif
 
+#ifdef CONFIG_USE_IO_URING
+	#include "BaseSocket.h"
+	#include "SocketIOURING.h"
+	#include "SocketMgrIOURING.h"
+	#include "ListenSocketIOURING.h"
+#endif
+
 #ifdef CONFIG_USE_KEVENT
     #include "BaseSocket.h"
     #include "SocketKEVENT.h"
@@ -59,6 +74,7 @@
 #endif
 
 #include "SocketGarbageCollector.h"
+#include "HttpSocket.h"
 
 /** Connect to a server.
 * @param hostname Hostname or IP address to connect to
@@ -97,4 +113,41 @@ static T* ConnectTCPSocket(const char * hostname, u_short port, uint32 timeout =
     }
 }
 
+#ifdef CONFIG_USE_EPOLL
+/** Connect to a server without blocking, result is reported by OnConnect/OnError on reactor thread.
+* @param hostname Hostname or IP address to connect to (resolved synchronously)
+* @param port Port to connect to
+* @param timeout connect timeout in seconds, OnError(ETIMEDOUT) is called after it
+* @return templated type if connect was started, otherwise null
+*/
+template<class T>
+static T* ConnectTCPSocketAsync(const char * hostname, u_short port, uint32 timeout = 3)
+{
+	struct hostent * ci = gethostbyname(hostname);
+	if(ci == NULL)
+		return NULL;
+    
+    //create peer info
+    sockaddr_in peer;
+    memset(&peer, 0, sizeof(sockaddr_in));
+	peer.sin_family = ci->h_addrtype;
+	peer.sin_port = ntohs(port);
+	memcpy(&peer.sin_addr.s_addr, ci->h_addr_list[0], ci->h_length);
+    
+    //socket constructor sets fd non-blocking
+    SOCKET fd = SocketOps::CreateTCPFileDescriptor();
+    T * s = new T(fd);
+    if(s->ConnectAsync(&peer, timeout))
+    {
+        return s;
+    }
+    else
+    {
+        SocketOps::CloseSocket(fd);
+        s->Delete();
+        return NULL;
+    }
+}
+#endif
+
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef PACKET_DECODER_H
+#define PACKET_DECODER_H
+
+#include "../Packets/Packets.h"
+
+#ifndef PACKET_DECODER_MAX_LENGTH
+    #define PACKET_DECODER_MAX_LENGTH (1024 * 1024)     //longer frame is protocol error
+#endif
+
+/** Frame header - opcode followed by body length, host byte order
+ */
+template<typename TOpcode, typename TLength>
+struct PacketHeader
+{
+    static const size_t HeaderSize = sizeof(TOpcode) + sizeof(TLength);
+    
+    static INLINE uint16 GetOpcode(const uint8 * pHeader)
+    {
+        TOpcode opcode;
+        memcpy(&opcode, pHeader, sizeof(TOpcode));
+        return static_cast<uint16>(opcode);
+    }
+    
+    static INLINE size_t GetLength(const uint8 * pHeader)
+    {
+        TLength length;
+        memcpy(&length, pHeader + sizeof(TOpcode), sizeof(TLength));
+        return static_cast<size_t>(length);
+    }
+};
+
+typedef std::vector<Packet*> PacketVec;
+
+/** Decoder of length-prefixed frames from socket read buffer (CircularBuffer or ChunkedBuffer).
+ * Header is parsed in place from contiguous read region, only header wrapping around buffer end
+ * is copied out. Body is copied once - directly from read buffer to Packet. Body which is not
+ * received yet is kept in pending Packet, so frame can be longer than read buffer.
+ *
+ * Usage in OnRead():
+ *     PacketVec rPackets;
+ *     if(!m_rDecoder.Decode(GetReadBuffer(), rPackets))
+ *         Disconnect();
+ *     //process and delete rPackets
+ */
+template<class THeader = PacketHeader<uint16, uint32> >
+class PacketDecoder
+{
+public:
+    explicit PacketDecoder(size_t maxLength = PACKET_DECODER_MAX_LENGTH) : m_maxLength(maxLength), m_pPending(NULL), m_remaining(0)
+    {
+    }
+    
+    ~PacketDecoder()
+    {
+        delete m_pPending;
+    }
+    
+    /** Consumes all complete frames from buffer
+     * @param rBuffer read buffer of socket
+     * @param rPackets receives decoded packets, caller takes ownership
+     * @return false if frame is longer than max length - connection should be closed
+     */
+    template<class TBuffer>
+    bool Decode(TBuffer & rBuffer, PacketVec & rPackets)
+    {
+        for(;;)
+        {
+            if(m_pPending == NULL)
+            {
+                if(rBuffer.GetSize() < THeader::HeaderSize)
+                    break;
+                
+                //parse header in place, copy only if it wraps around
+                uint8 rHeader[THeader::HeaderSize];
+                const uint8 *pHeader;
+                bool contiguous = rBuffer.GetContiguiousBytes() >= THeader::HeaderSize;
+                if(contiguous)
+                {
+                    pHeader = static_cast<const uint8*>(rBuffer.GetBufferStart());
+                }
+                else
+                {
+                    rBuffer.Read(rHeader, THeader::HeaderSize);
+                    pHeader = rHeader;
+                }
+                
+                uint16 opcode = THeader::GetOpcode(pHeader);
+                size_t length = THeader::GetLength(pHeader);
+                if(contiguous)
+                {
+                    rBuffer.Remove(THeader::HeaderSize);
+                }
+                
+                if(length > m_maxLength)
+                {
+                    Log.Warning(__FUNCTION__, "Frame with opcode %u has length %u, max is %u", opcode, (uint32)length, (uint32)m_maxLength);
+                    return false;
+                }
+                
+                m_pPending = new Packet(opcode, length);
+                m_remaining = length;
+            }
+            
+            //copy body region by region
+            while(m_remaining != 0 && rBuffer.GetSize() != 0)
+            {
+                size_t bytes = std::min(rBuffer.GetContiguiousBytes(), m_remaining);
+                m_pPending->append(rBuffer.GetBufferStart(), bytes);
+                rBuffer.Remove(bytes);
+                m_remaining -= bytes;
+            }
+            
+            if(m_remaining != 0)
+                break;
+            
+            rPackets.push_back(m_pPending);
+            m_pPending = NULL;
+        }
+        return true;
+    }
+    
+    /** Drops partially received frame
+     */
+    void Reset()
+    {
+        delete m_pPending;
+        m_pPending = NULL;
+        m_remaining = 0;
+    }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(PacketDecoder);
+    
+    size_t      m_maxLength;
+    Packet      *m_pPending;        //frame with incomplete body
+    size_t      m_remaining;        //body bytes missing in pending frame
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+SocketCompression::SocketCompression(int compressionLevel, int windowBits, int memLevel) : m_output(SOCKET_COMPRESSION_READ_SIZE), m_input(SOCKET_COMPRESSION_READ_SIZE), m_inputPos(0)
+{
+    memset(&m_deflate, 0, sizeof(z_stream));
+    memset(&m_inflate, 0, sizeof(z_stream));
+    
+    //negative window bits - raw deflate without header and checksum
+    m_initResult = deflateInit2(&m_deflate, compressionLevel, Z_DEFLATED, -windowBits, memLevel, Z_DEFAULT_STRATEGY);
+    if(m_initResult != Z_OK)
+        return;
+    
+    m_initResult = inflateInit2(&m_inflate, -windowBits);
+    if(m_initResult != Z_OK)
+    {
+        deflateEnd(&m_deflate);
+    }
+}
+
+SocketCompression::~SocketCompression()
+{
+    if(m_initResult == Z_OK)
+    {
+        deflateEnd(&m_deflate);
+        inflateEnd(&m_inflate);
+    }
+}
+
+ByteBuffer & SocketCompression::Deflate(const void * pData, size_t bytes, int flush)
+{
+    m_output.resize(0);
+    
+    m_deflate.next_in = static_cast<Bytef*>(const_cast<void*>(pData));
+    m_deflate.avail_in = static_cast<uInt>(bytes);
+    
+    //write directly to output tail, until deflate leaves free space - input consumed and flushed
+    do
+    {
+        size_t size = m_output.size();
+        if(m_output.capacity() - size < 64)
+        {
+            m_output.reserve(m_output.capacity() * 2);
+        }
+        
+        m_deflate.next_out = m_output.storage() + size;
+        m_deflate.avail_out = static_cast<uInt>(m_output.capacity() - size);
+        deflate(&m_deflate, flush);
+        m_output.resize(static_cast<size_t>(m_deflate.next_out - m_output.storage()));
+    }while(m_deflate.avail_out == 0);
+    
+    return m_output;
+}
+
+uint8 * SocketCompression::GetInputSpace(size_t bytes)
+{
+    //move not inflated rest to front
+    size_t pending = m_input.size() - m_inputPos;
+    if(m_inputPos != 0)
+    {
+        if(pending != 0)
+        {
+            memmove(m_input.storage(), m_input.storage() + m_inputPos, pending);
+        }
+        m_input.resize(pending);
+        m_inputPos = 0;
+    }
+    
+    m_input.reserve(pending + bytes);
+    return m_input.storage() + pending;
+}
+
+void SocketCompression::CommitInput(size_t bytes)
+{
+    m_input.resize(m_input.size() + bytes);
+}
+
+bool SocketCompression::Inflate(void * pOut, size_t outSize, size_t & rProduced)
+{
+    m_inflate.next_in = m_input.storage() + m_inputPos;
+    m_inflate.avail_in = static_cast<uInt>(m_input.size() - m_inputPos);
+    m_inflate.next_out = static_cast<Bytef*>(pOut);
+    m_inflate.avail_out = static_cast<uInt>(outSize);
+    
+    int ret = inflate(&m_inflate, Z_SYNC_FLUSH);
+    
+    rProduced = outSize - m_inflate.avail_out;
+    m_inputPos = m_input.size() - m_inflate.avail_in;
+    if(m_inputPos == m_input.size())
+    {
+        m_input.resize(0);
+        m_inputPos = 0;
+    }
+    
+    switch(ret)
+    {
+        case Z_OK:
+        case Z_BUF_ERROR:       //no progress - needs more input
+            return true;
+        case Z_STREAM_END:
+        {
+            //peer finished stream, next data start new one
+            inflateReset(&m_inflate);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
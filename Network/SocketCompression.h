@@ -0,0 +1,86 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SOCKET_COMPRESSION_H
+#define SOCKET_COMPRESSION_H
+
+#include "../zlib/zlib.h"
+
+#ifndef SOCKET_COMPRESSION_READ_SIZE
+    #define SOCKET_COMPRESSION_READ_SIZE 16384      //compressed bytes read from socket at once
+#endif
+#ifndef SOCKET_COMPRESSION_MAX_PENDING
+    #define SOCKET_COMPRESSION_MAX_PENDING 65536    //compressed bytes not inflated yet, socket is disconnected over it
+#endif
+
+/** Streaming compression of whole connection (permessage-deflate style) - raw deflate stream
+ * with persistent context in each direction, outbound data are sync flushed on every burst
+ * so peer can inflate them immediately. Both peers must enable it with same window size.
+ */
+class SocketCompression
+{
+public:
+    /** @param windowBits 9-15, size of history window (shared dictionary)
+     *  @param memLevel 1-9, memory used by deflate state
+     */
+    explicit SocketCompression(int compressionLevel, int windowBits, int memLevel);
+    ~SocketCompression();
+    
+    /** Z_OK if both streams were initialized
+     */
+    int GetInitResult() const   { return m_initResult; }
+    
+    /** Compresses outbound data, output is valid until next call
+     * @param flush Z_NO_FLUSH or Z_SYNC_FLUSH
+     */
+    ByteBuffer & Deflate(const void * pData, size_t bytes, int flush);
+    
+    /** Returns space for at least bytes of compressed input read from socket
+     */
+    uint8 * GetInputSpace(size_t bytes);
+    
+    /** Commits compressed input written to GetInputSpace
+     */
+    void CommitInput(size_t bytes);
+    
+    /** Inflates pending input to pOut
+     * @param rProduced number of bytes written to pOut
+     * @return false on corrupted stream
+     */
+    bool Inflate(void * pOut, size_t outSize, size_t & rProduced);
+    
+    /** Compressed input which was not inflated yet (incomplete end of stream)
+     */
+    size_t GetInputSize() const { return m_input.size() - m_inputPos; }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(SocketCompression);
+    
+    z_stream    m_deflate;
+    z_stream    m_inflate;
+    int         m_initResult;
+    
+    ByteBuffer  m_output;       //compressed outbound data
+    ByteBuffer  m_input;        //compressed inbound data
+    size_t      m_inputPos;     //inflated part of m_input
+};
+
+#endif
@@ -45,9 +45,18 @@
     #include <sys/event.h>
 #elif defined(CONFIG_USE_EPOLL)
     //Linux epoll scokets
+    //define CONFIG_EPOLL_EDGE_TRIGGERED for EPOLLET mode (registered once, drained until EAGAIN)
     #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+#elif defined(CONFIG_USE_IO_URING)
+    //Linux io_uring sockets (kernel 6.0+ for multishot recv with provided buffer ring)
+    #include <linux/io_uring.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <poll.h>
 #else
-    #error "Please define CONFIG_USE_IOCP for Windows, CONFIG_USE_SELECT for select, CONFIG_USE_KEVENT kevent, CONFIG_USE_EPOLL for epoll"
+    #error "Please define CONFIG_USE_IOCP for Windows, CONFIG_USE_SELECT for select, CONFIG_USE_KEVENT kevent, CONFIG_USE_EPOLL for epoll, CONFIG_USE_IO_URING for io_uring"
 #endif
 
 //
@@ -55,7 +64,32 @@
     #define SOCKET_SEND_RECV_TIMEOUT 15
 #endif
 #ifndef MAX_EVENTS
-    #define MAX_EVENTS 32
+    #define MAX_EVENTS 32               //initial size of epoll event array
+#endif
+#ifndef MAX_EVENTS_LIMIT
+    #define MAX_EVENTS_LIMIT 1024       //epoll event array doubles on full batch up to this size
+#endif
+#ifndef SOCKET_BUSY_POLL
+    #define SOCKET_BUSY_POLL 0          //us, reactor polls epoll without blocking for this long before it sleeps, 0 = block
+#endif
+#ifndef SOCKET_REACTOR_COUNT
+    #define SOCKET_REACTOR_COUNT 1
+#endif
+#ifndef SOCKET_TIMER_TICK
+    #define SOCKET_TIMER_TICK 100   //ms, resolution of reactor timers (idle timeouts, deferred deletion)
+#endif
+#ifndef SOCKET_MAX_IOVECS
+    #define SOCKET_MAX_IOVECS 16
+#endif
+//define CONFIG_SOCKET_CHUNKED_BUFFERS to use growable ChunkedBuffer (chunks from per-reactor pool) instead of fixed CircularBuffer
+#ifndef SOCKET_URING_ENTRIES
+    #define SOCKET_URING_ENTRIES 4096       //submission queue size
+#endif
+#ifndef SOCKET_URING_BUFFER_COUNT
+    #define SOCKET_URING_BUFFER_COUNT 4096  //provided recv buffers, power of 2
+#endif
+#ifndef SOCKET_URING_BUFFER_SIZE
+    #define SOCKET_URING_BUFFER_SIZE 4096
 #endif
 
 /* IOCP Defines */
@@ -109,4 +143,31 @@ struct OverlappedStruct
 
 #endif
 
+/* io_uring Defines */
+
+#ifdef CONFIG_USE_IO_URING
+enum SocketIOEvent : uint8
+{
+	SOCKET_IO_EVENT_ACCEPT			= 0,
+	SOCKET_IO_EVENT_READ_COMPLETE	= 1,
+	SOCKET_IO_EVENT_WRITE_END		= 2,
+	SOCKET_IO_EVENT_WAKEUP			= 3,
+	NUM_SOCKET_IO_EVENTS			= 4,
+};
+
+/** Submitted operation, its address is user_data of SQE
+ */
+struct UringOperation
+{
+	explicit UringOperation(SocketIOEvent ev, void * pOwner) : m_event(ev), m_pOwner(pOwner), m_pending(0)
+	{
+	}
+
+	uint8				m_event;
+	void				*m_pOwner;
+	uint32				m_pending;		//submitted SQEs without final CQE - worker thread only
+};
+
+#endif
+
 #endif
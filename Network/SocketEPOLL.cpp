@@ -45,13 +45,40 @@ Socket::Socket(SOCKET fd, size_t readbuffersize, size_t writebuffersize) : m_rea
 	SocketOps::SetTimeout(m_fd, SOCKET_SEND_RECV_TIMEOUT);
 
 	m_writeLock 	= 0;
+	m_disconnectAfterSend = false;
+	m_pReactor		= NULL;
+	m_pCompression	= NULL;
+	m_sendScheduled	= false;
+	m_rPendingNode.m_pSocket = this;
+	m_rTimerNode.m_pSocket = this;
+	m_rTimer.m_pCallback = &Socket::OnTimer;
+	m_rTimer.m_pParam = this;
+	m_timerType		= SOCKET_TIMER_NONE;
+	m_timerScheduled = false;
+	m_idleTimeout	= 0;
+	m_connectTimeout = 0;
+	m_connecting	= false;
+	m_lastActivity	= 0;
 	m_deleted 		= false;
 	m_connected 	= false;
 }
 
 Socket::~Socket()
 {
+	//release queued frames and shared buffers
+	OutboundFrame *pFrame;
+	while((pFrame = m_outboundFrames.pop()) != NULL)
+	{
+		FreeFrame(pFrame);
+	}
+	ClearSendQueue();
+	delete m_pCompression;
 	
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+	//return chunks to reactor pool
+	m_readBuffer.Clear();
+	m_writeBuffer.Clear();
+#endif
 }
 
 bool BaseSocket::Connect(SOCKET fd, const sockaddr_in *peer, uint32 timeout)
@@ -103,30 +130,357 @@ void Socket::Accept(const sockaddr_in * peer)
 	_OnConnect();	
 }
 
+void Socket::BindReactor()
+{
+	//pick reactor
+	if(m_pReactor == NULL)
+	{
+		m_pReactor = sSocketMgr.GetNextReactor();
+	}
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+	m_readBuffer.SetPool(m_pReactor->GetBufferPool());
+	m_writeBuffer.SetPool(m_pReactor->GetBufferPool());
+#endif
+}
+
+bool Socket::ConnectAsync(const sockaddr_in * peer, uint32 timeout)
+{
+	memcpy(&m_peer, peer, sizeof(sockaddr));
+	BindReactor();
+	
+	int result = connect(m_fd, (const sockaddr*)peer, sizeof(sockaddr_in));
+	if(result == 0)
+	{
+		//connected immediately (localhost)
+		_OnConnect();
+		return true;
+	}
+	else if(errno != EINPROGRESS)
+	{
+		Log.Error(__FUNCTION__, "connect failed on fd %u, errno %u (%s)", m_fd, errno, strerror(errno));
+		return false;
+	}
+	
+	m_connectTimeout = timeout;
+	m_connecting = true;
+	
+#ifdef CONFIG_EPOLL_EDGE_TRIGGERED
+	//EPOLLOUT edge signals connect result
+	sSocketMgr.AddSocket(this, false, m_pReactor);
+#else
+	//registered for EPOLLOUT, write lock is released by write handler after connect completes
+	IncSendLock();
+	sSocketMgr.AddSocket(this, false, m_pReactor);
+#endif
+	
+	//arm connect timer
+	if(m_connectTimeout != 0)
+	{
+		ScheduleTimerUpdate();
+	}
+	return true;
+}
+
+bool Socket::CompleteConnect()
+{
+	int so_error = 0;
+	socklen_t len = sizeof(so_error);
+	if(getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &so_error, &len) != 0)
+	{
+		so_error = errno;
+	}
+	
+	if(so_error != 0)
+	{
+		//Disconnect aborts pending connect
+		OnError(so_error);
+		return false;
+	}
+	
+	//aborted meanwhile
+	if(!m_connecting.exchange(false))
+		return false;
+	
+	m_connected = true;
+	
+	//cancel connect timer, arm idle timer
+	ApplyTimer();
+	
+	// Call virtual onconnect
+	OnConnect();
+	return m_connected;
+}
+
 void Socket::_OnConnect()
 {
 	m_connected = true;
 	
-	//add to socket mgr
-	sSocketMgr.AddSocket(this, false);
+	//pick reactor and add to socket mgr
+	BindReactor();
+	sSocketMgr.AddSocket(this, false, m_pReactor);
+	
+	//arm idle timer
+	if(m_idleTimeout != 0)
+	{
+		ScheduleTimerUpdate();
+	}
 	
 	// Call virtual onconnect
 	OnConnect();
 }
 
+void Socket::SetIdleTimeout(uint32 timeout)
+{
+	m_idleTimeout = timeout;
+	if(m_connected)
+	{
+		ScheduleTimerUpdate();
+	}
+}
+
+void Socket::ScheduleTimerUpdate()
+{
+	if(!m_timerScheduled.exchange(true))
+	{
+		m_pReactor->ScheduleTimer(&m_rTimerNode);
+	}
+}
+
+void Socket::UpdateTimer()
+{
+	m_timerScheduled = false;
+	ApplyTimer();
+}
+
+void Socket::ApplyTimer()
+{
+	//waiting for deletion, nothing can change it
+	if(m_timerType == SOCKET_TIMER_DELETE)
+		return;
+	
+	TimerWheel & rTimers = m_pReactor->GetTimers();
+	if(m_deleted)
+	{
+		m_timerType = SOCKET_TIMER_DELETE;
+		rTimers.Schedule(&m_rTimer, m_pReactor->GetTime() + SOCKET_GC_TIMEOUT * 1000);
+	}
+	else if(m_connected && m_idleTimeout != 0)
+	{
+		//idle time is counted from arming of timer or last read
+		if(m_timerType != SOCKET_TIMER_IDLE)
+		{
+			m_timerType = SOCKET_TIMER_IDLE;
+			m_lastActivity = m_pReactor->GetTime();
+		}
+		rTimers.Schedule(&m_rTimer, m_lastActivity + m_idleTimeout * 1000ULL);
+	}
+	else if(m_connecting && m_connectTimeout != 0)
+	{
+		if(m_timerType != SOCKET_TIMER_CONNECT)
+		{
+			m_timerType = SOCKET_TIMER_CONNECT;
+			rTimers.Schedule(&m_rTimer, m_pReactor->GetTime() + m_connectTimeout * 1000ULL);
+		}
+	}
+	else if(m_timerType != SOCKET_TIMER_NONE)
+	{
+		m_timerType = SOCKET_TIMER_NONE;
+		rTimers.Cancel(&m_rTimer);
+	}
+}
+
+void Socket::OnTimer(TimerNode * pNode)
+{
+	Socket *pSocket = static_cast<Socket*>(pNode->m_pParam);
+	
+	//reactor teardown - clock is frozen, only deferred deletion is finished
+	if(pSocket->m_timerType != SOCKET_TIMER_DELETE && pSocket->m_pReactor->IsShuttingDown())
+	{
+		pSocket->m_timerType = SOCKET_TIMER_NONE;
+		return;
+	}
+	
+	switch(pSocket->m_timerType)
+	{
+		case SOCKET_TIMER_DELETE:
+			{
+				delete pSocket;
+			}
+			break;
+		case SOCKET_TIMER_IDLE:
+			{
+				if(!pSocket->m_connected || pSocket->m_idleTimeout == 0)
+				{
+					pSocket->m_timerType = SOCKET_TIMER_NONE;
+					break;
+				}
+				
+				//data received meanwhile - sleep for the rest of timeout, reads do not touch timer
+				uint64 now = pSocket->m_pReactor->GetTime();
+				uint64 expire = pSocket->m_lastActivity + pSocket->m_idleTimeout * 1000ULL;
+				if(expire > now)
+				{
+					pSocket->m_pReactor->GetTimers().Schedule(&pSocket->m_rTimer, expire);
+					break;
+				}
+				
+				//re-arm before callback, keepalive can be sent from it
+				pSocket->m_lastActivity = now;
+				pSocket->m_pReactor->GetTimers().Schedule(&pSocket->m_rTimer, now + pSocket->m_idleTimeout * 1000ULL);
+				pSocket->OnIdleTimeout();
+			}
+			break;
+		case SOCKET_TIMER_CONNECT:
+			{
+				pSocket->m_timerType = SOCKET_TIMER_NONE;
+				if(pSocket->m_connecting)
+				{
+					Log.Debug(__FUNCTION__, "Connect timeout on fd %u", pSocket->m_fd);
+					pSocket->OnError(ETIMEDOUT);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+#ifdef CONFIG_EPOLL_EDGE_TRIGGERED
+
 /* This is called when the socket engine gets an event on the socket */
 void Socket::ReadCallback(size_t len)
 {
-	/* Any other platform, we have to call recv() to actually get the data. */
-	size_t space = m_readBuffer.GetSpace();
-	int bytes = recv(m_fd, m_readBuffer.GetBuffer(), space, 0);
+	if(m_pCompression != NULL)
+	{
+		ReadCompressed();
+		return;
+	}
+	
+	/* Edge triggered - we will not be notified again until we read everything, so drain until EAGAIN. */
+	struct iovec rVec[SOCKET_MAX_IOVECS];
+	for(;;)
+	{
+		/* fill both free regions of circular buffer at once */
+		size_t count = m_readBuffer.GetFreeRegions(rVec, SOCKET_MAX_IOVECS);
+		if(count == 0)
+		{
+			/* give consumer chance to free buffer */
+			OnRead();
+			count = m_readBuffer.GetFreeRegions(rVec, SOCKET_MAX_IOVECS);
+			if(count == 0)
+			{
+				/* consumer does not make progress - edge will not come again for data left in kernel buffer,
+				   disconnect same as level triggered read into full buffer */
+				Log.Warning(__FUNCTION__, "Read buffer full on fd %u, disconnecting", m_fd);
+				Disconnect();
+				return;
+			}
+		}
+		
+		ssize_t bytes = readv(m_fd, rVec, static_cast<int>(count));
+		AddMetric(SOCKET_COUNTER_RECV_CALLS, 1);
+		if(bytes < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Disconnect();
+			}
+			else
+			{
+				AddMetric(SOCKET_COUNTER_RECV_EAGAIN, 1);
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+				/* nothing more to read, do not keep empty chunk on idle connection */
+				m_readBuffer.ReleaseIdle();
+#endif
+			}
+			return;
+		}
+		else if(bytes == 0)
+		{
+			Disconnect();
+			return;
+		}
+		
+		m_readBuffer.IncrementWrittenRegions(bytes);
+		m_lastActivity = m_pReactor->GetTime();
+		AddMetric(SOCKET_COUNTER_RECV_BYTES, bytes);
+		OnRead();
+		
+		/* OnRead can disconnect socket */
+		if(!m_connected)
+			return;
+	}
+}
+
+/* This is called when the socket engine gets an event on the socket */
+void Socket::WriteCallback(size_t len)
+{
+	// We should already be locked at this point, so try to push everything out until EAGAIN.
+	struct iovec rVec[SOCKET_MAX_IOVECS];
+	struct msghdr rMsg;
+	while(Writable())
+	{
+		/* send both regions of circular buffer and queued shared buffers in one call */
+		memset(&rMsg, 0, sizeof(rMsg));
+		rMsg.msg_iov = rVec;
+		rMsg.msg_iovlen = FillSendVector(rVec, SOCKET_MAX_IOVECS);
+		
+		ssize_t bytes = sendmsg(m_fd, &rMsg, MSG_NOSIGNAL);
+		AddMetric(SOCKET_COUNTER_SEND_CALLS, 1);
+		if(bytes < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Disconnect();
+			}
+			else
+			{
+				AddMetric(SOCKET_COUNTER_SEND_EAGAIN, 1);
+			}
+			return;
+		}
+		
+		CountSent(rVec, rMsg.msg_iovlen, bytes);
+		ConsumeSent(bytes);
+	}
+	
+	if(m_disconnectAfterSend)
+	{
+		Disconnect();
+	}
+}
+
+#else
+
+/* This is called when the socket engine gets an event on the socket */
+void Socket::ReadCallback(size_t len)
+{
+	if(m_pCompression != NULL)
+	{
+		ReadCompressed();
+		return;
+	}
+	
+	/* Any other platform, we have to call recv() to actually get the data - fill both free regions at once. */
+	struct iovec rVec[SOCKET_MAX_IOVECS];
+	size_t count = m_readBuffer.GetFreeRegions(rVec, SOCKET_MAX_IOVECS);
+	ssize_t bytes = readv(m_fd, rVec, static_cast<int>(count));
+	AddMetric(SOCKET_COUNTER_RECV_CALLS, 1);
 	if(bytes <= 0)
 	{
 		Disconnect();
 	}
 	else
 	{
-		m_readBuffer.IncrementWritten(bytes);
+		m_readBuffer.IncrementWrittenRegions(bytes);
+		m_lastActivity = m_pReactor->GetTime();
+		AddMetric(SOCKET_COUNTER_RECV_BYTES, bytes);
 		OnRead();
 	}
 }
@@ -134,38 +488,499 @@ void Socket::ReadCallback(size_t len)
 /* This is called when the socket engine gets an event on the socket */
 void Socket::WriteCallback(size_t len)
 {
-	// We should already be locked at this point, so try to push everything out.
-	int bytes = send(m_fd, m_writeBuffer.GetBufferStart(), m_writeBuffer.GetContiguiousBytes(), 0);
+	// We should already be locked at this point, so try to push everything out - both regions in one call.
+	struct iovec rVec[SOCKET_MAX_IOVECS];
+	struct msghdr rMsg;
+	memset(&rMsg, 0, sizeof(rMsg));
+	rMsg.msg_iov = rVec;
+	rMsg.msg_iovlen = FillSendVector(rVec, SOCKET_MAX_IOVECS);
+	
+	ssize_t bytes = sendmsg(m_fd, &rMsg, 0);
+	AddMetric(SOCKET_COUNTER_SEND_CALLS, 1);
 	if(bytes < 0)
+	{
+		//EAGAIN, EINTR - data stay in buffer, reactor re-arms EPOLLOUT while socket is writable
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			AddMetric(SOCKET_COUNTER_SEND_EAGAIN, 1);
+		}
+		else if(errno != EINTR)
+		{
+			Disconnect();
+		}
+		return;
+	}
+
+	CountSent(rVec, rMsg.msg_iovlen, bytes);
+	ConsumeSent(bytes);
+	
+	if(m_disconnectAfterSend && !Writable())
 	{
 		Disconnect();
+	}
+}
+
+#endif
+
+bool Socket::EnableCompression(int compressionLevel, int windowBits, int memLevel)
+{
+	if(m_pCompression != NULL)
+		return true;
+	
+	SocketCompression *pCompression = new SocketCompression(compressionLevel, windowBits, memLevel);
+	if(pCompression->GetInitResult() != Z_OK)
+	{
+		Log.Error(__FUNCTION__, "Could not initialize compression on fd %u, zlib error %d", m_fd, pCompression->GetInitResult());
+		delete pCompression;
+		return false;
+	}
+	
+	m_pCompression = pCompression;
+	return true;
+}
+
+void Socket::ReadCompressed()
+{
+	/* Edge triggered mode drains socket until EAGAIN, level triggered reads once */
+	for(;;)
+	{
+		/* only incomplete tail of stream can be pending here, anything bigger is broken peer */
+		if(m_pCompression->GetInputSize() > SOCKET_COMPRESSION_MAX_PENDING)
+		{
+			Log.Warning(__FUNCTION__, "Too much compressed input pending on fd %u, disconnecting", m_fd);
+			Disconnect();
+			return;
+		}
+		
+		uint8 *pInput = m_pCompression->GetInputSpace(SOCKET_COMPRESSION_READ_SIZE);
+		ssize_t bytes = read(m_fd, pInput, SOCKET_COMPRESSION_READ_SIZE);
+		AddMetric(SOCKET_COUNTER_RECV_CALLS, 1);
+		if(bytes < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Disconnect();
+			}
+			else
+			{
+				AddMetric(SOCKET_COUNTER_RECV_EAGAIN, 1);
+			}
+			return;
+		}
+		else if(bytes == 0)
+		{
+			Disconnect();
+			return;
+		}
+		
+		m_pCompression->CommitInput(bytes);
+		m_lastActivity = m_pReactor->GetTime();
+		AddMetric(SOCKET_COUNTER_RECV_BYTES, bytes);
+		
+		if(!InflateInput())
+			return;
+		
+#ifndef CONFIG_EPOLL_EDGE_TRIGGERED
 		return;
+#endif
 	}
+}
+
+bool Socket::InflateInput()
+{
+	/* inflate fills one region at a time - do not take spare chunks it would not use */
+	struct iovec rVec[1];
+	while(m_pCompression->GetInputSize() != 0)
+	{
+		size_t count = m_readBuffer.GetFreeRegions(rVec, 1);
+		if(count == 0)
+		{
+			/* give consumer chance to free buffer */
+			OnRead();
+			if(!m_connected)
+				return false;
+			
+			count = m_readBuffer.GetFreeRegions(rVec, 1);
+			if(count == 0)
+			{
+				/* consumer does not make progress - same as full read buffer without compression,
+				   pending input would only grow and it is inflated only when more data come */
+				Log.Warning(__FUNCTION__, "Read buffer full on fd %u, %u compressed bytes are pending, disconnecting", m_fd, (uint32)m_pCompression->GetInputSize());
+				Disconnect();
+				return false;
+			}
+		}
+		
+		size_t inputSize = m_pCompression->GetInputSize();
+		size_t produced;
+		if(!m_pCompression->Inflate(rVec[0].iov_base, rVec[0].iov_len, produced))
+		{
+			Log.Error(__FUNCTION__, "Corrupted compressed stream on fd %u", m_fd);
+			Disconnect();
+			return false;
+		}
+		
+		m_readBuffer.IncrementWrittenRegions(produced);
+		
+		/* rest of input is incomplete */
+		if(produced == 0 && inputSize == m_pCompression->GetInputSize())
+			break;
+	}
+	
+	if(m_readBuffer.GetSize() != 0)
+	{
+		OnRead();
+	}
+	return m_connected;
+}
 
-	m_writeBuffer.Remove(bytes);
+void Socket::AddMetric(SocketCounter counter, uint64 value)
+{
+	m_rCounters.Add(counter, value);
+	
+	if(m_pReactor != NULL)
+	{
+		//reactor thread writes without locked add, other threads (BurstSend, edge triggered BurstPush) use shared counters
+		if(m_pReactor->IsOwnerThread())
+		{
+			m_pReactor->GetMetrics().AddOwner(counter, value);
+		}
+		else
+		{
+			m_pReactor->GetMetrics().AddShared(counter, value);
+		}
+	}
+}
+
+void Socket::CountSent(const struct iovec * pVec, size_t count, size_t bytes)
+{
+	size_t requested = 0;
+	for(size_t i = 0;i < count;++i)
+	{
+		requested += pVec[i].iov_len;
+	}
+	
+	AddMetric(SOCKET_COUNTER_SEND_BYTES, bytes);
+	if(bytes < requested)
+	{
+		AddMetric(SOCKET_COUNTER_SHORT_WRITES, 1);
+	}
+}
+
+size_t Socket::FillSendVector(struct iovec * pVec, size_t maxCount)
+{
+	// fast path - only copied data
+	if(m_sendQueue.empty())
+	{
+		return m_writeBuffer.GetDataRegions(pVec, maxCount);
+	}
+
+	// copied data are described by inline segments, map them to write buffer regions in order
+	struct iovec rBufferVec[SOCKET_MAX_IOVECS];
+	size_t bufferCount = m_writeBuffer.GetDataRegions(rBufferVec, SOCKET_MAX_IOVECS);
+	size_t bufferIndex = 0;
+	size_t bufferOffset = 0;
+	size_t count = 0;
+
+	for(OutboundQueue::iterator itr = m_sendQueue.begin();itr != m_sendQueue.end() && count < maxCount;++itr)
+	{
+		if(itr->m_pBuffer != NULL)
+		{
+			// fully sent buffer is released by ConsumeSent, do not pass empty iovec
+			if(itr->m_offset == itr->m_pBuffer->size())
+				continue;
+			
+			pVec[count].iov_base = (void*)(itr->m_pBuffer->contents() + itr->m_offset);
+			pVec[count].iov_len = itr->m_pBuffer->size() - itr->m_offset;
+			++count;
+			continue;
+		}
+
+		size_t remaining = itr->m_size;
+		while(remaining > 0 && bufferIndex < bufferCount && count < maxCount)
+		{
+			size_t chunk = std::min(remaining, rBufferVec[bufferIndex].iov_len - bufferOffset);
+			pVec[count].iov_base = static_cast<uint8*>(rBufferVec[bufferIndex].iov_base) + bufferOffset;
+			pVec[count].iov_len = chunk;
+			++count;
+
+			remaining -= chunk;
+			bufferOffset += chunk;
+			if(bufferOffset == rBufferVec[bufferIndex].iov_len)
+			{
+				++bufferIndex;
+				bufferOffset = 0;
+			}
+		}
+
+		// data of following segments must not be sent before this one
+		if(remaining > 0)
+			break;
+	}
+
+	return count;
+}
+
+void Socket::ConsumeSent(size_t bytes)
+{
+	if(m_sendQueue.empty())
+	{
+		m_writeBuffer.Remove(bytes);
+		return;
+	}
+
+	// zero length segments are dropped even when nothing was sent, otherwise queue stays writable forever
+	while(!m_sendQueue.empty())
+	{
+		OutboundSegment &rSegment = m_sendQueue.front();
+		if(rSegment.m_pBuffer != NULL)
+		{
+			size_t sent = std::min(bytes, rSegment.m_pBuffer->size() - rSegment.m_offset);
+			rSegment.m_offset += sent;
+			bytes -= sent;
+			if(rSegment.m_offset != rSegment.m_pBuffer->size())
+				break;
+			
+			rSegment.m_pBuffer->release();
+			m_sendQueue.pop_front();
+		}
+		else
+		{
+			size_t sent = std::min(bytes, rSegment.m_size);
+			m_writeBuffer.Remove(sent);
+			rSegment.m_size -= sent;
+			bytes -= sent;
+			if(rSegment.m_size != 0)
+				break;
+			
+			m_sendQueue.pop_front();
+		}
+	}
+}
+
+void Socket::ClearSendQueue()
+{
+	for(OutboundQueue::iterator itr = m_sendQueue.begin();itr != m_sendQueue.end();++itr)
+	{
+		if(itr->m_pBuffer != NULL)
+		{
+			itr->m_pBuffer->release();
+		}
+	}
+	m_sendQueue.clear();
+}
+
+bool Socket::WriteRaw(const void * data, size_t bytes, bool bKeep)
+{
+	// empty segment would never be consumed
+	if(bytes == 0)
+		return true;
+	
+	if(!m_writeBuffer.Write(data, bytes))
+	{
+		AddMetric(SOCKET_COUNTER_BUFFER_FULL, 1);
+		if(!bKeep)
+			return false;
+		
+		//compressed stream can not lose data - queue them behind write buffer
+		SharedByteBuffer *pBuffer = new SharedByteBuffer(bytes);
+		pBuffer->append(data, bytes);
+		QueueShared(pBuffer);
+		return true;
+	}
+
+	// shared buffers are queued - keep order
+	if(!m_sendQueue.empty())
+	{
+		if(m_sendQueue.back().m_pBuffer == NULL)
+		{
+			m_sendQueue.back().m_size += bytes;
+		}
+		else
+		{
+			m_sendQueue.push_back(OutboundSegment(NULL, bytes));
+		}
+	}
+	return true;
 }
 
 bool Socket::BurstSend(const void * data, size_t bytes)
 {
-	return m_writeBuffer.Write(data, bytes);
+	if(m_pCompression != NULL)
+	{
+		//deflate keeps data until flush in BurstPush
+		ByteBuffer & rOutput = m_pCompression->Deflate(data, bytes, Z_NO_FLUSH);
+		return rOutput.size() == 0 || WriteRaw(rOutput.contents(), rOutput.size(), true);
+	}
+	
+	return WriteRaw(data, bytes, false);
+}
+
+bool Socket::BurstSend(SharedByteBuffer * pBuffer)
+{
+	// nothing to send
+	if(pBuffer->size() == 0)
+	{
+		pBuffer->release();
+		return true;
+	}
+
+	// shared buffer is compressed for every socket - no zero copy
+	if(m_pCompression != NULL)
+	{
+		bool result = BurstSend(pBuffer->contents(), pBuffer->size());
+		pBuffer->release();
+		return result;
+	}
+
+	QueueShared(pBuffer);
+	return true;
+}
+
+void Socket::QueueShared(SharedByteBuffer * pBuffer)
+{
+	// data already copied into write buffer goes first
+	if(m_sendQueue.empty() && m_writeBuffer.GetSize() > 0)
+	{
+		m_sendQueue.push_back(OutboundSegment(NULL, m_writeBuffer.GetSize()));
+	}
+
+	m_sendQueue.push_back(OutboundSegment(pBuffer, 0));
+}
+
+bool Socket::QueueSend(const void * data, size_t bytes)
+{
+	if(!m_connected || m_pReactor == NULL)
+		return false;
+
+	OutboundFrame *pFrame = static_cast<OutboundFrame*>(_MALLOC(sizeof(OutboundFrame) + bytes));
+	new(pFrame) OutboundFrame();
+	pFrame->m_pBuffer = NULL;
+	pFrame->m_size = bytes;
+	memcpy(pFrame->m_data, data, bytes);
+
+	QueueFrame(pFrame);
+	return true;
+}
+
+bool Socket::QueueSend(SharedByteBuffer * pBuffer)
+{
+	if(!m_connected || m_pReactor == NULL)
+	{
+		pBuffer->release();
+		return false;
+	}
+
+	OutboundFrame *pFrame = static_cast<OutboundFrame*>(_MALLOC(sizeof(OutboundFrame)));
+	new(pFrame) OutboundFrame();
+	pFrame->m_pBuffer = pBuffer;
+	pFrame->m_size = 0;
+
+	QueueFrame(pFrame);
+	return true;
+}
+
+void Socket::QueueFrame(OutboundFrame * pFrame)
+{
+	m_outboundFrames.push(pFrame);
+
+	//first frame since last flush - let reactor know
+	if(!m_sendScheduled.exchange(true))
+	{
+		m_pReactor->ScheduleSend(&m_rPendingNode);
+	}
+}
+
+void Socket::FreeFrame(OutboundFrame * pFrame)
+{
+	if(pFrame->m_pBuffer != NULL)
+	{
+		pFrame->m_pBuffer->release();
+	}
+	pFrame->~OutboundFrame();
+	_FREE(pFrame);
+}
+
+void Socket::FlushQueuedSends()
+{
+	//reset before draining - frame pushed after this point schedules flush again
+	m_sendScheduled = false;
+
+	//only reactor thread takes write lock now - uncontended
+	BurstBegin();
+
+	OutboundFrame *pFrame;
+	while((pFrame = m_outboundFrames.pop()) != NULL)
+	{
+		if(m_connected)
+		{
+			if(pFrame->m_pBuffer != NULL)
+			{
+				BurstSend(pFrame->m_pBuffer);
+				pFrame->m_pBuffer = NULL;
+			}
+			else if(!BurstSend(pFrame->m_data, pFrame->m_size))
+			{
+				//write buffer is full - do not drop data, queue it as shared buffer
+				SharedByteBuffer *pBuffer = new SharedByteBuffer(pFrame->m_size);
+				pBuffer->append(pFrame->m_data, pFrame->m_size);
+				BurstSend(pBuffer);
+			}
+		}
+		FreeFrame(pFrame);
+	}
+
+	//compressed data can wait in deflate state - flush them too
+	if(m_connected && (Writable() || m_pCompression != NULL))
+	{
+		BurstPush();
+	}
+
+	BurstEnd();
 }
 
 void Socket::BurstPush()
 {
+	//end of burst - peer gets everything compressed so far
+	if(m_pCompression != NULL)
+	{
+		ByteBuffer & rOutput = m_pCompression->Deflate(NULL, 0, Z_SYNC_FLUSH);
+		if(rOutput.size() != 0)
+		{
+			WriteRaw(rOutput.contents(), rOutput.size(), true);
+		}
+	}
+	
+#ifdef CONFIG_EPOLL_EDGE_TRIGGERED
+	/* EPOLLOUT is registered once and never re-armed, edge will not come while socket is writable
+	   so flush directly - caller holds write lock (BurstBegin), rest is sent on next EPOLLOUT edge. */
+	if(m_connected)
+	{
+		WriteCallback(0);
+	}
+#else
 	if(AcquireSendLock())
 	{
 		PostEvent(EPOLLOUT);
 	}
+#endif
 }
 
 void Socket::Disconnect()
 {
-	if(!m_connected) 
+	//pending async connect is aborted without OnDisconnect
+	bool wasConnected = m_connected.exchange(false);
+	bool wasConnecting = m_connecting.exchange(false);
+	if(!wasConnected && !wasConnecting) 
 		return;
-		
-	m_connected = false;
 
-	OnDisconnect();
+	if(wasConnected)
+	{
+		OnDisconnect();
+	}
 	sSocketMgr.RemoveSocket(this);
 	SocketOps::CloseSocket(m_fd);
 
@@ -182,12 +997,36 @@ void Socket::Delete()
 		
 	m_deleted = true;
 
-	if(m_connected) 
+	if(m_connected || m_connecting) 
 	{
 		Disconnect();	
 	}
 	
-	sSocketGarbageCollector.QueueSocket(this);	
+	//deferred deletion on reactor timer, socket never bound to reactor goes to garbage collector
+	if(m_pReactor != NULL)
+	{
+		ScheduleTimerUpdate();
+	}
+	else
+	{
+		sSocketGarbageCollector.QueueSocket(this);
+	}
+}
+
+void Socket::DisconnectAfterSend()
+{
+	BurstBegin();
+	bool pending = Writable();
+	if(pending)
+	{
+		m_disconnectAfterSend = true;
+	}
+	BurstEnd();
+	
+	if(!pending)
+	{
+		Disconnect();
+	}
 }
 
 void Socket::OnError(int errcode)
@@ -198,7 +1037,7 @@ void Socket::OnError(int errcode)
 
 bool Socket::Writable() const
 {
-	return (m_writeBuffer.GetSize() > 0) ? true : false;
+	return (m_writeBuffer.GetSize() > 0 || !m_sendQueue.empty()) ? true : false;
 }
 
 std::string Socket::GetRemoteIP()
@@ -212,7 +1051,7 @@ std::string Socket::GetRemoteIP()
 
 void Socket::PostEvent(int events)
 {
-	int epoll_fd = sSocketMgr.GetEpollFd();
+	int epoll_fd = m_pReactor->GetEpollFd();
 
 	struct epoll_event ev;
 	memset(&ev, 0, sizeof(epoll_event));
@@ -23,13 +23,38 @@
 
 #include "SocketDefines.h"
 
+class SocketReactor;
+class Socket;
+
+/** Frame queued by QueueSend - shared buffer or copied data
+ */
+struct OutboundFrame : public MPSCNode
+{
+	SharedByteBuffer	*m_pBuffer;
+	size_t				m_size;
+	uint8				m_data[1];
+};
+
+/** Node of reactor's list of sockets with queued frames
+ */
+struct SocketPendingNode : public MPSCNode
+{
+	Socket				*m_pSocket;
+};
+
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+typedef ChunkedBuffer	SocketBuffer;
+#else
+typedef CircularBuffer	SocketBuffer;
+#endif
+
 class Socket : public BaseSocket
 {
 public:
 	/** Constructor
 	 * @param fd File descriptor to use with this socket
-	 * @param readbuffersize Incoming data buffer size
-	 * @param writebuffersize Outgoing data buffer size
+	 * @param readbuffersize Incoming data buffer size (max size in chunked mode)
+	 * @param writebuffersize Outgoing data buffer size (max size in chunked mode)
 	 * @param peer Connection
 	 */
 	Socket(SOCKET fd, size_t readbuffersize, size_t writebuffersize);
@@ -54,6 +79,26 @@ public:
 	 */
 	bool BurstSend(const void * data, size_t bytes);
 
+	/** Queues shared buffer, it is sent directly from its storage without copy.
+	 * Takes ownership of one reference - call retain() before for every socket when broadcasting.
+	 */
+	bool BurstSend(SharedByteBuffer * pBuffer);
+
+	/** Queues data to lock-free outbound queue, never blocks - can be called from any thread.
+	 * Data are moved to write buffer and sent by reactor thread owning this socket.
+	 * @return false if socket is not connected
+	 */
+	bool QueueSend(const void * data, size_t bytes);
+
+	/** Queues shared buffer to lock-free outbound queue, takes ownership of one reference.
+	 * @return false if socket is not connected (reference is released)
+	 */
+	bool QueueSend(SharedByteBuffer * pBuffer);
+
+	/** Moves queued frames to write buffer and starts sending - called by owning reactor thread
+	 */
+	void FlushQueuedSends();
+
 	/** Burst system - Pushes event to queue - do at the end of write events.
 	 */
 	void BurstPush();
@@ -67,6 +112,10 @@ public:
 	 */
 	void Delete();
 
+	/** Disconnects the socket once everything in write buffer is sent (response with Connection: close)
+	 */
+	void DisconnectAfterSend();
+
 	/** Implemented ReadCallback()
 	 */
 	void ReadCallback(size_t len);
@@ -78,6 +127,49 @@ public:
 	/* */
 	void Accept(const sockaddr_in * peer);
 
+	/** Sets idle timeout in seconds, OnIdleTimeout is called when nothing is received for this time, 0 - disabled
+	 */
+	void SetIdleTimeout(uint32 timeout);
+
+	/** Called by reactor thread when idle timeout expires - disconnects by default,
+	 * override to send keepalive instead (timer is already re-armed)
+	 */
+	virtual void OnIdleTimeout()	{ Disconnect(); }
+
+	/** Applies idle/connect timeout and deletion to socket's timer - called by owning reactor thread
+	 */
+	void UpdateTimer();
+
+	/** Starts non-blocking connect, result is reported on reactor thread by OnConnect or OnError
+	 * (ETIMEDOUT after timeout seconds, 0 - no timeout).
+	 * @return false if connect failed immediately - socket is not registered, caller closes it
+	 */
+	bool ConnectAsync(const sockaddr_in * peer, uint32 timeout);
+
+	/** Finishes async connect on reactor event
+	 * @return true if socket is connected and event should be processed
+	 */
+	bool CompleteConnect();
+
+	/** Is async connect in progress?
+	 */
+	bool IsConnecting() const	{ return m_connecting; }
+
+	/** Adds socket's counters (calls, bytes, EAGAIN...) to snapshot - any thread
+	 */
+	void GetMetrics(SocketMetricsSnapshot & rSnapshot) const	{ m_rCounters.AddTo(rSnapshot); }
+
+	/** Binds socket to reactor, must be called before Accept - otherwise reactor is chosen in round robin
+	 */
+	void SetReactor(SocketReactor * pReactor)	{ m_pReactor = pReactor; }
+
+	/** Enables streaming compression of connection in both directions, peer has to enable it too.
+	 * Call before any data are sent or received (before Accept/connect).
+	 * @param windowBits 9-15, size of shared history window
+	 * @param memLevel 1-9, memory used by deflate state
+	 */
+	bool EnableCompression(int compressionLevel = Z_DEFAULT_COMPRESSION, int windowBits = MAX_WBITS, int memLevel = 8);
+
 	/** Get IP in numerical form
 	 */
 	const char * GetIP() { return inet_ntoa(m_peer.sin_addr); }
@@ -92,8 +184,8 @@ public:
 	
 	/** If for some reason we need to access the buffers directly 
 	 */
-	INLINE CircularBuffer & GetReadBuffer()		{ return m_readBuffer; }
-	INLINE CircularBuffer & GetWriteBuffer()	{ return m_writeBuffer; }	
+	INLINE SocketBuffer & GetReadBuffer()		{ return m_readBuffer; }
+	INLINE SocketBuffer & GetWriteBuffer()		{ return m_writeBuffer; }	
 	
 	// Posts a kevent with the specifed arguments.
 	void PostEvent(int events);
@@ -139,19 +231,141 @@ protected:
 	 */
 	std::atomic<bool>   m_deleted;
 	std::atomic<bool>   m_connected;
+	std::atomic<bool>   m_connecting;
     
 	/** Called when connection is opened.
 	 */ 
 	void _OnConnect();
 
+	/** Picks reactor (if not set) and its buffer pool
+	 */
+	void BindReactor();
+
 	/** Connected peer
 	 */
 	sockaddr_in         m_peer;
 
 	/** Read (inbound)/Write (outbound) buffer
 	 */
-	CircularBuffer      m_readBuffer;
-	CircularBuffer      m_writeBuffer;
+	SocketBuffer        m_readBuffer;
+	SocketBuffer        m_writeBuffer;
+
+	/** Part of outbound stream - shared buffer or m_size bytes copied in write buffer
+	 */
+	struct OutboundSegment
+	{
+		explicit OutboundSegment(SharedByteBuffer * pBuffer, size_t size) : m_pBuffer(pBuffer), m_offset(0), m_size(size)
+		{
+		}
+
+		SharedByteBuffer	*m_pBuffer;
+		size_t				m_offset;
+		size_t				m_size;
+	};
+	typedef std::deque<OutboundSegment>	OutboundQueue;
+
+	/** Fills iovecs with outbound data in order, returns number of iovecs
+	 */
+	size_t FillSendVector(struct iovec * pVec, size_t maxCount);
+
+	/** Removes sent bytes from write buffer/shared buffers
+	 */
+	void ConsumeSent(size_t bytes);
+
+	/** Releases all queued shared buffers
+	 */
+	void ClearSendQueue();
+
+	/** Shared buffers queue, empty if only copied data are pending
+	 */
+	OutboundQueue		m_sendQueue;
+
+	/** Queues frame and schedules flush on reactor
+	 */
+	void QueueFrame(OutboundFrame * pFrame);
+
+	/** Frees frame which was not sent
+	 */
+	void FreeFrame(OutboundFrame * pFrame);
+
+	/** Lock-free outbound frames filled by QueueSend, drained by reactor thread
+	 */
+	MPSCQueue<OutboundFrame>	m_outboundFrames;
+	std::atomic<bool>			m_sendScheduled;
+	SocketPendingNode			m_rPendingNode;
+
+	/** Schedules UpdateTimer on reactor thread
+	 */
+	void ScheduleTimerUpdate();
+
+	/** Sets timer by socket state - reactor thread
+	 */
+	void ApplyTimer();
+
+	/** Reactor timer callback
+	 */
+	static void OnTimer(TimerNode * pNode);
+
+	enum SocketTimerType
+	{
+		SOCKET_TIMER_NONE	= 0,
+		SOCKET_TIMER_IDLE	= 1,
+		SOCKET_TIMER_DELETE	= 2,
+		SOCKET_TIMER_CONNECT	= 3,
+	};
+
+	/** One timer per socket, its meaning depends on socket state - reactor thread only
+	 */
+	TimerNode			m_rTimer;
+	uint32				m_timerType;
+	SocketPendingNode	m_rTimerNode;
+	std::atomic<bool>	m_timerScheduled;
+
+	/** Idle timeout in seconds and time of last read (reactor time in ms)
+	 */
+	std::atomic<uint32>	m_idleTimeout;
+	uint64				m_lastActivity;
+
+	/** Async connect timeout in seconds
+	 */
+	uint32				m_connectTimeout;
+
+	/** Adds value to socket's and reactor's counter
+	 */
+	void AddMetric(SocketCounter counter, uint64 value);
+
+	/** Counts sent bytes and short write
+	 */
+	void CountSent(const struct iovec * pVec, size_t count, size_t bytes);
+
+	/** Per socket counters
+	 */
+	SocketCounters		m_rCounters;
+
+	/** Copies data to write buffer, data which do not fit are queued as shared buffer if bKeep is set
+	 */
+	bool WriteRaw(const void * data, size_t bytes, bool bKeep);
+
+	/** Queues shared buffer without compression
+	 */
+	void QueueShared(SharedByteBuffer * pBuffer);
+
+	/** Reads compressed data and inflates them to read buffer
+	 */
+	void ReadCompressed();
+
+	/** Inflates pending compressed input to read buffer and calls OnRead
+	 * @return false if socket was disconnected
+	 */
+	bool InflateInput();
+
+	/** Compression filter, NULL if disabled
+	 */
+	SocketCompression	*m_pCompression;
+
+	/** Reactor owning this socket, assigned on connect and kept for whole lifetime
+	 */
+	SocketReactor       *m_pReactor;
 
 	/** Socket's write buffer protection
 	 */
@@ -160,6 +374,10 @@ protected:
 	/** Write lock, stops multiple write events from being posted.
 	 */ 
 	std::atomic<long>   m_writeLock;
+
+	/** WriteCallback disconnects when write buffer is flushed - guarded by m_writeMutex
+	 */
+	bool                m_disconnectAfterSend;
 };
 
 #endif
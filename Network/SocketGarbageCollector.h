@@ -26,19 +26,21 @@
 /* Socket Garbage Collector */
 #define SOCKET_GC_TIMEOUT 15
 
-typedef std::map<Socket*, time_t> DeletionQueueMap;
+//timeout is same for all sockets - queue is sorted by deletion time
+typedef std::deque<std::pair<Socket*, time_t> > DeletionQueue;
 
+/* Sockets queued by engines without reactor timers (and epoll sockets never bound to reactor) */
 class SocketGarbageCollector : public Singleton<SocketGarbageCollector>
 {
 private:
-	volatile DeletionQueueMap	m_deletionQueue;
+	volatile DeletionQueue		m_deletionQueue;
     std::mutex					m_DelLock;
 
 public:
 	~SocketGarbageCollector()
 	{
-		LockingPtr<DeletionQueueMap> pDeletionQueue(m_deletionQueue, m_DelLock);
-		for(DeletionQueueMap::iterator itr = pDeletionQueue->begin();itr != pDeletionQueue->end();++itr)
+		LockingPtr<DeletionQueue> pDeletionQueue(m_deletionQueue, m_DelLock);
+		for(DeletionQueue::iterator itr = pDeletionQueue->begin();itr != pDeletionQueue->end();++itr)
 		{
 			delete itr->first;
 		}
@@ -46,25 +48,21 @@ public:
 
 	void Update()
 	{
-		LockingPtr<DeletionQueueMap> pDeletionQueue(m_deletionQueue, m_DelLock);
+		LockingPtr<DeletionQueue> pDeletionQueue(m_deletionQueue, m_DelLock);
 
-		DeletionQueueMap::iterator i, i2;
+		//only expired sockets are visited
 		time_t t = UNIXTIME;
-		for(i = pDeletionQueue->begin(); i != pDeletionQueue->end();)
+		while(!pDeletionQueue->empty() && pDeletionQueue->front().second <= t)
 		{
-			i2 = i++;
-			if(i2->second <= t)
-			{
-				delete i2->first;
-				pDeletionQueue->erase(i2);
-			}
+			delete pDeletionQueue->front().first;
+			pDeletionQueue->pop_front();
 		}
 	}
 
 	void QueueSocket(Socket * s)
 	{
-		LockingPtr<DeletionQueueMap> pDeletionQueue(m_deletionQueue, m_DelLock);
-		pDeletionQueue->insert(DeletionQueueMap::value_type(s, UNIXTIME + SOCKET_GC_TIMEOUT));
+		LockingPtr<DeletionQueue> pDeletionQueue(m_deletionQueue, m_DelLock);
+		pDeletionQueue->push_back(DeletionQueue::value_type(s, UNIXTIME + SOCKET_GC_TIMEOUT));
 	}
 };
 
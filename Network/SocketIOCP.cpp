@@ -25,6 +25,7 @@ Socket::Socket(SOCKET fd, uint32 sendbuffersize, uint32 recvbuffersize) : m_fd(f
 {
 	// IOCP Member Variables
 	m_writeLock = 0;
+	m_disconnectAfterSend = false;
 	m_completionPort = 0;
 
 	// Check for needed fd allocation.
@@ -110,6 +111,22 @@ bool Socket::BurstSend(const void * data, size_t bytes)
 	return m_writeBuffer.Write(data, bytes);
 }
 
+void Socket::DisconnectAfterSend()
+{
+	BurstBegin();
+	bool pending = Writable();
+	if(pending)
+	{
+		m_disconnectAfterSend = true;
+	}
+	BurstEnd();
+	
+	if(!pending)
+	{
+		Disconnect();
+	}
+}
+
 void Socket::OnError(int errcode)
 {
 	Log.Debug(__FUNCTION__, "Error number: %u", errcode);
@@ -194,6 +211,10 @@ void Socket::WriteCallback(size_t len)
 	{
 		// Write operation is completed.
 		DecSendLock();
+		if(m_disconnectAfterSend)
+		{
+			Disconnect();
+		}
 	}
 }
 
@@ -0,0 +1,252 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+#ifdef CONFIG_USE_IO_URING
+
+Socket::Socket(SOCKET fd, size_t readbuffersize, size_t writebuffersize) : m_fd(fd), m_deleted(false), m_connected(false), m_readBuffer(readbuffersize), m_writeBuffer(writebuffersize),
+	m_readEvent(SOCKET_IO_EVENT_READ_COMPLETE, this), m_writeEvent(SOCKET_IO_EVENT_WRITE_END, this), m_requests(0)
+{
+	m_writeLock = 0;
+	m_disconnectAfterSend = false;
+	m_rRequestNode.m_pSocket = this;
+
+	// Check for needed fd allocation.
+	if(m_fd == 0)
+	{
+		m_fd = SocketOps::CreateTCPFileDescriptor();
+	}
+
+	/* disable nagle buffering by default */
+	SocketOps::DisableBuffering(m_fd);
+
+    /* set keep alive */
+    SocketOps::KeepAlive(m_fd);
+}
+
+Socket::~Socket()
+{
+
+}
+
+bool BaseSocket::Connect(SOCKET fd, const sockaddr_in *peer, uint32 timeout)
+{
+    //set non-blocking
+    SocketOps::Nonblocking(fd);
+    
+    //try to connect
+    int result = connect(fd, (const sockaddr*)peer, sizeof(sockaddr_in));
+    if(result == 0 || errno != EINPROGRESS)
+    {
+        Log.Error(__FUNCTION__, "result == %d, errno = %d", result, errno);
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout * 1000));
+        return false;
+    }
+    
+    //async socket connect
+    struct pollfd rPollFd;
+    rPollFd.fd = fd;
+    rPollFd.events = POLLOUT;
+    rPollFd.revents = 0;
+    
+    bool oResult = false;
+    if(poll(&rPollFd, 1, timeout * 1000) == 1)
+    {
+        int so_error;
+        socklen_t len = sizeof(so_error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+        if(so_error == 0)
+        {
+            oResult = true;
+        }
+        else
+        {
+            Log.Error(__FUNCTION__, "SO_ERROR: %d", so_error);
+        }
+    }
+    
+    //io_uring does not need non-blocking socket
+    SocketOps::Blocking(fd);
+    return oResult;
+}
+
+void Socket::Accept(const sockaddr_in * peer)
+{
+	memcpy(&m_peer, peer, sizeof(sockaddr_in));
+	_OnConnect();
+}
+
+void Socket::_OnConnect()
+{
+	m_connected = true;
+	sSocketMgr.AddSocket(this);
+
+	// arm multishot recv on worker thread
+	PostRequest(SOCKET_REQUEST_RECV);
+
+	// Call virtual onconnect
+	OnConnect();
+}
+
+void Socket::PostRequest(uint32 request)
+{
+	//node is queued only once until worker takes requests
+	if(m_requests.fetch_or(request) == 0)
+	{
+		sSocketMgr.ScheduleRequest(&m_rRequestNode);
+	}
+}
+
+bool Socket::BurstSend(const void * data, size_t bytes)
+{
+	return m_writeBuffer.Write(data, bytes);
+}
+
+void Socket::BurstPush()
+{
+	if(AcquireSendLock())
+	{
+		PostRequest(SOCKET_REQUEST_SEND);
+	}
+}
+
+void Socket::ReadCallback(size_t /*len*/)
+{
+	OnRead();
+}
+
+void Socket::WriteCallback(size_t /*len*/)
+{
+	//sends in flight - completion continues
+	if(m_writeEvent.m_pending != 0)
+		return;
+
+	struct iovec rVec[2];
+	size_t count = m_writeBuffer.GetDataRegions(rVec, 2);
+	if(count == 0)
+	{
+		// Write operation is completed.
+		DecSendLock();
+		if(m_disconnectAfterSend)
+		{
+			Disconnect();
+		}
+		return;
+	}
+
+	// both regions are sent by linked sends, MSG_WAITALL breaks link on short send - stream order is kept
+	// whole chain goes to one submission, flush of full SQ between links would cut it
+	sSocketMgr.ReserveSqes(static_cast<uint32>(count));
+	for(size_t i = 0;i < count;++i)
+	{
+		struct io_uring_sqe *pSqe = sSocketMgr.GetSqe();
+		pSqe->opcode = IORING_OP_SEND;
+		pSqe->fd = m_fd;
+		pSqe->addr = reinterpret_cast<uint64>(rVec[i].iov_base);
+		pSqe->len = static_cast<uint32>(rVec[i].iov_len);
+		pSqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		pSqe->user_data = reinterpret_cast<uint64>(&m_writeEvent);
+		if(i + 1 < count)
+		{
+			pSqe->flags |= IOSQE_IO_LINK;
+		}
+		++m_writeEvent.m_pending;
+	}
+}
+
+void Socket::Disconnect()
+{
+	if(!m_connected.exchange(false))
+		return;
+
+	// remove from mgr
+	sSocketMgr.RemoveSocket(this);
+
+	// shutdown finishes recv/sends in flight, fd is closed by worker thread after them
+	shutdown(m_fd, SD_BOTH);
+	PostRequest(SOCKET_REQUEST_CLOSE);
+
+	// Call virtual ondisconnect
+	OnDisconnect();
+
+	if(!m_deleted)
+	{
+		Delete();
+	}
+}
+
+void Socket::Delete()
+{
+	if(m_deleted)
+		return;
+
+	m_deleted = true;
+
+	if(m_connected) 
+	{
+		Disconnect();
+	}
+
+	sSocketGarbageCollector.QueueSocket(this);
+}
+
+void Socket::DisconnectAfterSend()
+{
+	BurstBegin();
+	bool pending = Writable();
+	if(pending)
+	{
+		m_disconnectAfterSend = true;
+	}
+	BurstEnd();
+	
+	if(!pending)
+	{
+		Disconnect();
+	}
+}
+
+void Socket::OnError(int errcode)
+{
+	Log.Debug(__FUNCTION__, "Error number: %u", errcode);
+	Disconnect();
+}
+
+bool Socket::Writable() const
+{
+	return (m_writeBuffer.GetSize() > 0) ? true : false;
+}
+
+std::string Socket::GetRemoteIP()
+{
+	char* ip = (char*)inet_ntoa(m_peer.sin_addr);
+	if(ip != NULL)
+		return std::string(ip);
+	else
+		return std::string("noip");
+}
+
+void Socket::PostEvent(int /*events*/)
+{
+	//Not for io_uring
+}
+
+#endif
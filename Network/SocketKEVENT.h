@@ -66,6 +66,10 @@ public:
 	/** Queues the socket for deletion, and disconnects it, if it is connected
 	 */
 	void Delete();
+
+	/** Disconnects the socket once everything in write buffer is sent (response with Connection: close)
+	 */
+	void DisconnectAfterSend();
     
 	/** Implemented ReadCallback()
 	 */
@@ -160,6 +164,10 @@ protected:
 	/** Write lock, stops multiple write events from being posted.
 	 */ 
 	std::atomic<long> 	m_writeLock;
+
+	/** WriteCallback disconnects when write buffer is flushed - guarded by m_writeMutex
+	 */
+	bool                m_disconnectAfterSend;
 };
 
 #endif
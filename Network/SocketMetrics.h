@@ -0,0 +1,217 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SOCKET_METRICS_H
+#define SOCKET_METRICS_H
+
+/* Histogram buckets - bucket i holds values in <2^(i-1), 2^i), last bucket holds rest */
+#define SOCKET_HISTOGRAM_BUCKETS 32
+
+enum SocketCounter
+{
+    SOCKET_COUNTER_RECV_CALLS       = 0,
+    SOCKET_COUNTER_RECV_BYTES       = 1,
+    SOCKET_COUNTER_RECV_EAGAIN      = 2,
+    SOCKET_COUNTER_SEND_CALLS       = 3,
+    SOCKET_COUNTER_SEND_BYTES       = 4,
+    SOCKET_COUNTER_SEND_EAGAIN      = 5,
+    SOCKET_COUNTER_SHORT_WRITES     = 6,
+    SOCKET_COUNTER_BUFFER_FULL      = 7,    //BurstSend rejected by full write buffer
+    SOCKET_COUNTER_COUNT
+};
+
+enum SocketHistogram
+{
+    SOCKET_HISTOGRAM_EPOLL_BATCH    = 0,    //events returned by one epoll_wait
+    SOCKET_HISTOGRAM_READ_LATENCY   = 1,    //ns spent in ReadCallback
+    SOCKET_HISTOGRAM_WRITE_LATENCY  = 2,    //ns spent in write event handling
+    SOCKET_HISTOGRAM_COUNT
+};
+
+/** Plain copy of metrics, filled on demand
+ */
+struct SocketMetricsSnapshot
+{
+    SocketMetricsSnapshot()
+    {
+        Clear();
+    }
+    
+    void Clear()
+    {
+        memset(m_counters, 0, sizeof(m_counters));
+        memset(m_histograms, 0, sizeof(m_histograms));
+    }
+    
+    /** Upper bound of bucket
+     */
+    static uint64 GetBucketLimit(uint32 bucket)
+    {
+        return (bucket + 1 < SOCKET_HISTOGRAM_BUCKETS) ? (1ULL << bucket) : UINT64_MAX;
+    }
+    
+    /** Returns upper bound of bucket containing percentile (0 - 100), 0 if histogram is empty
+     */
+    uint64 GetPercentile(SocketHistogram histogram, double percentile) const
+    {
+        uint64 total = 0;
+        for(uint32 i = 0;i < SOCKET_HISTOGRAM_BUCKETS;++i)
+        {
+            total += m_histograms[histogram][i];
+        }
+        
+        if(total == 0)
+            return 0;
+        
+        uint64 limit = static_cast<uint64>(total * percentile / 100.0);
+        uint64 count = 0;
+        for(uint32 i = 0;i < SOCKET_HISTOGRAM_BUCKETS;++i)
+        {
+            count += m_histograms[histogram][i];
+            if(count >= limit && count != 0)
+                return GetBucketLimit(i);
+        }
+        return GetBucketLimit(SOCKET_HISTOGRAM_BUCKETS - 1);
+    }
+    
+    uint64  m_counters[SOCKET_COUNTER_COUNT];
+    uint64  m_histograms[SOCKET_HISTOGRAM_COUNT][SOCKET_HISTOGRAM_BUCKETS];
+};
+
+/** Counters of one socket - relaxed atomics, writers are practically never contended
+ */
+class SocketCounters
+{
+public:
+    SocketCounters()
+    {
+        for(uint32 i = 0;i < SOCKET_COUNTER_COUNT;++i)
+        {
+            m_counters[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    INLINE void Add(SocketCounter counter, uint64 value)
+    {
+        m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+    
+    /** Add without locked instruction - owning thread only
+     */
+    INLINE void AddOwner(SocketCounter counter, uint64 value)
+    {
+        //single writer - no need for locked add
+        std::atomic<uint64> & rCounter = m_counters[counter];
+        rCounter.store(rCounter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    
+    INLINE uint64 Get(SocketCounter counter) const
+    {
+        return m_counters[counter].load(std::memory_order_relaxed);
+    }
+    
+    /** Adds counters to snapshot
+     */
+    void AddTo(SocketMetricsSnapshot & rSnapshot) const
+    {
+        for(uint32 i = 0;i < SOCKET_COUNTER_COUNT;++i)
+        {
+            rSnapshot.m_counters[i] += m_counters[i].load(std::memory_order_relaxed);
+        }
+    }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(SocketCounters);
+    
+    std::atomic<uint64> m_counters[SOCKET_COUNTER_COUNT];
+};
+
+/** Counters and histograms of one reactor thread - owning thread writes without locked add (AddOwner, Record),
+ * other threads have separate counters (AddShared) so no update is lost
+ */
+class SocketMetrics : public SocketCounters
+{
+public:
+    SocketMetrics()
+    {
+        for(uint32 i = 0;i < SOCKET_HISTOGRAM_COUNT;++i)
+        {
+            for(uint32 y = 0;y < SOCKET_HISTOGRAM_BUCKETS;++y)
+            {
+                m_histograms[i][y].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    /** Records value to histogram - owning thread only
+     */
+    INLINE void Record(SocketHistogram histogram, uint64 value)
+    {
+        uint32 bucket = 0;
+        while(value != 0 && bucket + 1 < SOCKET_HISTOGRAM_BUCKETS)
+        {
+            value >>= 1;
+            ++bucket;
+        }
+        
+        //single writer - no need for locked add
+        std::atomic<uint64> & rBucket = m_histograms[histogram][bucket];
+        rBucket.store(rBucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    
+    /** Adds to counter from other than owning thread
+     */
+    INLINE void AddShared(SocketCounter counter, uint64 value)
+    {
+        m_rShared.Add(counter, value);
+    }
+    
+    /** Adds counters and histograms to snapshot
+     */
+    void AddTo(SocketMetricsSnapshot & rSnapshot) const
+    {
+        SocketCounters::AddTo(rSnapshot);
+        m_rShared.AddTo(rSnapshot);
+        for(uint32 i = 0;i < SOCKET_HISTOGRAM_COUNT;++i)
+        {
+            for(uint32 y = 0;y < SOCKET_HISTOGRAM_BUCKETS;++y)
+            {
+                rSnapshot.m_histograms[i][y] += m_histograms[i][y].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    /** Monotonic time in ns for latency histograms
+     */
+    static INLINE uint64 GetTime()
+    {
+        return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(SocketMetrics);
+    
+    std::atomic<uint64> m_histograms[SOCKET_HISTOGRAM_COUNT][SOCKET_HISTOGRAM_BUCKETS];
+    SocketCounters      m_rShared;      //BurstSend, edge triggered BurstPush on game threads
+};
+
+#endif
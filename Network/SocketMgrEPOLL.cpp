@@ -23,7 +23,7 @@
 
 initialiseSingleton(SocketMgr);
 
-SocketMgr::SocketMgr()
+SocketReactor::SocketReactor(uint32 id) : m_id(id), m_wakeupPending(false), m_now(GetTickCount64()), m_rTimers(SOCKET_TIMER_TICK, m_now), m_shutdown(false), m_ownerThread(std::thread::id()), m_busyPoll(SOCKET_BUSY_POLL)
 {
     m_epoll_fd = epoll_create(MAX_EVENTS);
     if(m_epoll_fd == -1)
@@ -31,42 +31,201 @@ SocketMgr::SocketMgr()
         Log.Error(__FUNCTION__, "Could not create epoll fd (/dev/epoll).");
         exit(EXIT_FAILURE);
     }
+    
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_wakeup_fd == -1)
+    {
+        Log.Error(__FUNCTION__, "Could not create wakeup eventfd.");
+        exit(EXIT_FAILURE);
+    }
+    
+    //wakeup event is recognized by reactor pointer
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(epoll_event));
+    ev.data.ptr = this;
+    ev.events   = EPOLLIN;
+    if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &ev))
+    {
+        Log.Error(__FUNCTION__, "Could not add wakeup eventfd to epoll set.");
+        exit(EXIT_FAILURE);
+    }
 }
 
-SocketMgr::~SocketMgr()
+SocketReactor::~SocketReactor()
 {
+    //fire deferred deletions, idle and connect timers of sockets left open are cancelled
+    m_shutdown = true;
+    ProcessPendingTimers();
+    m_rTimers.ExpireAll();
+    
+    //deletions requested from fired callbacks
+    ProcessPendingTimers();
+    m_rTimers.ExpireAll();
+    
+    close(m_wakeup_fd);
     close(m_epoll_fd);
 }
 
-void SocketMgr::AddSocket(BaseSocket *pSocket, bool listenSocket)
+void SocketReactor::ScheduleSend(SocketPendingNode *pNode)
+{
+    m_pendingSends.push(pNode);
+    
+    //wake up reactor only once per batch
+    if(!m_wakeupPending.exchange(true))
+    {
+        uint64 value = 1;
+        if(write(m_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+            Log.Warning(__FUNCTION__, "Could not signal reactor %u, errno %u", m_id, errno);
+        }
+    }
+}
+
+void SocketReactor::ProcessPendingSends()
+{
+    uint64 value;
+    while(read(m_wakeup_fd, &value, sizeof(value)) > 0);
+    
+    //reset before draining - node pushed after this point signals again
+    m_wakeupPending = false;
+    
+    SocketPendingNode *pNode;
+    while((pNode = m_pendingSends.pop()) != NULL)
+    {
+        pNode->m_pSocket->FlushQueuedSends();
+    }
+    
+    ProcessPendingTimers();
+}
+
+void SocketReactor::ScheduleTimer(SocketPendingNode *pNode)
+{
+    m_pendingTimers.push(pNode);
+    
+    //shares wakeup with sends
+    if(!m_wakeupPending.exchange(true))
+    {
+        uint64 value = 1;
+        if(write(m_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+            Log.Warning(__FUNCTION__, "Could not signal reactor %u, errno %u", m_id, errno);
+        }
+    }
+}
+
+void SocketReactor::ProcessPendingTimers()
+{
+    SocketPendingNode *pNode;
+    while((pNode = m_pendingTimers.pop()) != NULL)
+    {
+        pNode->m_pSocket->UpdateTimer();
+    }
+}
+
+int SocketReactor::GetWaitTimeout() const
+{
+    int timeout = m_rTimers.GetTimeout(GetTickCount64());
+    if(timeout < 0 || timeout > 10000)
+    {
+        timeout = 10000;
+    }
+    return timeout;
+}
+
+SocketMgr::SocketMgr(uint32 reactorCount) : m_nextReactor(0)
+{
+    if(reactorCount == 0)
+    {
+        reactorCount = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    
+    m_reactors.reserve(reactorCount);
+    for(uint32 i = 0;i < reactorCount;++i)
+    {
+        m_reactors.push_back(new SocketReactor(i));
+    }
+}
+
+SocketMgr::~SocketMgr()
+{
+    for(SocketReactorVec::iterator itr = m_reactors.begin();itr != m_reactors.end();++itr)
+    {
+        delete *itr;
+    }
+    m_reactors.clear();
+}
+
+void SocketMgr::GetMetrics(SocketMetricsSnapshot & rSnapshot) const
+{
+    rSnapshot.Clear();
+    for(SocketReactorVec::const_iterator itr = m_reactors.begin();itr != m_reactors.end();++itr)
+    {
+        (*itr)->GetMetrics().AddTo(rSnapshot);
+    }
+}
+
+void SocketMgr::SetBusyPoll(uint32 busyPoll)
+{
+    for(SocketReactorVec::iterator itr = m_reactors.begin();itr != m_reactors.end();++itr)
+    {
+        (*itr)->SetBusyPoll(busyPoll);
+    }
+}
+
+SocketReactor * SocketMgr::GetNextReactor()
+{
+    return m_reactors[m_nextReactor++ % m_reactors.size()];
+}
+
+void SocketMgr::AddSocket(BaseSocket *pSocket, bool listenSocket, SocketReactor *pReactor)
 {
+	//already registered
+	if(pSocket->GetHandle() != 0)
+		return;
+	
+	if(pReactor == NULL)
+	{
+		pReactor = GetNextReactor();
+	}
+	
 	//add socket to storage
-	LockingPtr<SocketSet> pSockets(m_sockets, m_socketLock);
-	if(pSockets->find(pSocket) == pSockets->end())
+	SocketHandle handle = m_sockets.Add(pSocket, pReactor);
+	if(handle == 0)
+		return;
+	
+	//lost race with other AddSocket
+	if(pSocket->ExchangeHandle(handle) != 0)
 	{
-		pSockets->insert(pSocket);
+		m_sockets.Remove(handle);
+		return;
+	}
 
-		// Add epoll event based on socket activity.
-		struct epoll_event ev;
-		memset(&ev, 0, sizeof(epoll_event));
-		ev.data.ptr = pSocket;
-		ev.events 	= (pSocket->Writable()) ? EPOLLOUT : EPOLLIN;
-	
-		if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, pSocket->GetFd(), &ev))
-		{
-			Log.Warning(__FUNCTION__, "Could not add event to epoll set on fd %u", pSocket->GetFd());
-		}
+	// Add epoll event based on socket activity.
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(epoll_event));
+	ev.data.ptr = pSocket;
+#ifdef CONFIG_EPOLL_EDGE_TRIGGERED
+	// Register both directions once, socket is never re-armed. Listen socket stays level triggered.
+	ev.events 	= (listenSocket) ? EPOLLIN : (EPOLLIN | EPOLLOUT | EPOLLET);
+#else
+	// Connecting socket waits for EPOLLOUT - registered here, second epoll_ctl could race with close of fd.
+	ev.events 	= (pSocket->IsConnecting() || pSocket->Writable()) ? EPOLLOUT : EPOLLIN;
+#endif
+
+	if(epoll_ctl(pReactor->GetEpollFd(), EPOLL_CTL_ADD, pSocket->GetFd(), &ev))
+	{
+		Log.Warning(__FUNCTION__, "Could not add event to epoll set on fd %u", pSocket->GetFd());
 	}
 }
 
 void SocketMgr::RemoveSocket(BaseSocket *pSocket)
 {
-	//remove socket from storage
-	LockingPtr<SocketSet> pSockets(m_sockets, m_socketLock);	
-	SocketSet::iterator itr = pSockets->find(pSocket);
-	if(itr != pSockets->end())
+	//remove socket from storage, handle is cleared only once
+	void *pParam = NULL;
+	SocketHandle handle = pSocket->ExchangeHandle(0);
+	if(handle != 0 && m_sockets.Remove(handle, &pParam))
 	{
-		pSockets->erase(itr);
+        SocketReactor *pReactor = static_cast<SocketReactor*>(pParam);
 	
 		// Remove from epoll list.
 		struct epoll_event ev;
@@ -74,7 +233,7 @@ void SocketMgr::RemoveSocket(BaseSocket *pSocket)
 		ev.data.ptr = pSocket;
 		ev.events 	= (pSocket->Writable()) ? EPOLLOUT : EPOLLIN;
 
-		if(epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, pSocket->GetFd(), &ev))
+		if(epoll_ctl(pReactor->GetEpollFd(), EPOLL_CTL_DEL, pSocket->GetFd(), &ev))
 		{
 			Log.Warning(__FUNCTION__, "Could not remove fd %u from epoll set, errno %u", pSocket->GetFd(), errno);
 		}
@@ -83,68 +242,126 @@ void SocketMgr::RemoveSocket(BaseSocket *pSocket)
 
 void SocketMgr::CloseAll()
 {
-	LockingPtr<SocketSet> pSockets(m_sockets, NULL);
 	std::list<BaseSocket*> tokill;
-	
-	m_socketLock.lock();
-	for(SocketSet::iterator itr = pSockets->begin();itr != pSockets->end();++itr)
-	{
-		tokill.push_back(*itr);
-	}
-	m_socketLock.unlock();
+	m_sockets.GetSockets(tokill);
 	
 	for(std::list<BaseSocket*>::iterator itr = tokill.begin(); itr != tokill.end(); ++itr)
 	{
 		(*itr)->Disconnect();
 	}	
 	
-	size_t size = 0;
-	do
-	{
-		m_socketLock.lock();
-		size = pSockets->size();
-		m_socketLock.unlock();
-	}while(size);
+	//Disconnect removes socket from table
+	m_sockets.WaitEmpty();
 }
 
 void SocketMgr::SpawnWorkerThreads()
 {
-    ThreadPool.ExecuteTask(new SocketWorkerThread());
+    for(SocketReactorVec::iterator itr = m_reactors.begin();itr != m_reactors.end();++itr)
+    {
+        ThreadPool.ExecuteTask(new SocketWorkerThread(*itr));
+    }
+}
+
+int SocketWorkerThread::Wait()
+{
+    int fd_count;
+    int epoll_fd = m_pReactor->GetEpollFd();
+    int maxEvents = static_cast<int>(m_rEvents.size());
+    
+    //spin-then-block
+    uint32 busyPoll = m_pReactor->GetBusyPoll();
+    if(busyPoll != 0)
+    {
+        uint64 startTime = SocketMetrics::GetTime();
+        uint64 budget = static_cast<uint64>(busyPoll) * 1000;
+        do
+        {
+            fd_count = epoll_wait(epoll_fd, &m_rEvents[0], maxEvents, 0);
+            if(fd_count != 0)
+                return fd_count;
+        }while(SocketMetrics::GetTime() - startTime < budget);
+    }
+    
+    return epoll_wait(epoll_fd, &m_rEvents[0], maxEvents, m_pReactor->GetWaitTimeout());
 }
 
 bool SocketWorkerThread::run()
 {
-    CommonFunctions::SetThreadName("SocketWorker thread");    
+    CommonFunctions::SetThreadName("SocketWorker thread %u", m_pReactor->GetId());
+    m_pReactor->SetOwnerThread();
     //
 	int i;
     int fd_count;
-    Socket * pSocket;
-	int epoll_fd = sSocketMgr.GetEpollFd();
+    BaseSocket * pSocket;	//listen sockets share the loop
+    uint64 startTime;
+	SocketMetrics & rMetrics = m_pReactor->GetMetrics();
 			
     while(m_threadRunning)
     {
-        fd_count = epoll_wait(epoll_fd, m_rEvents, MAX_EVENTS, 10000);
+        fd_count = Wait();
+        
+        //time of this iteration
+        m_pReactor->RefreshTime();
+        rMetrics.Record(SOCKET_HISTOGRAM_EPOLL_BATCH, std::max(fd_count, 0));
+        
         for(i = 0; i < fd_count; ++i)
         {
-			pSocket = static_cast<Socket*>(m_rEvents[i].data.ptr);
+			//wakeup from QueueSend
+			if(m_rEvents[i].data.ptr == m_pReactor)
+			{
+				m_pReactor->ProcessPendingSends();
+				continue;
+			}
+			
+			pSocket = static_cast<BaseSocket*>(m_rEvents[i].data.ptr);
 			if(pSocket == NULL)
 			{
 				Log.Error(__FUNCTION__, "epoll returned invalid fd %u", m_rEvents[i].data.fd);
 				continue;
 			}
 			
+			//async connect result, on success event is processed as usual (buffered data are sent)
+			if(pSocket->IsConnecting() && !pSocket->CompleteConnect())
+			{
+				continue;
+			}
+			
 			if((m_rEvents[i].events & EPOLLHUP) || (m_rEvents[i].events & EPOLLERR))
 			{
 				pSocket->OnError(errno);
 			}
+#ifdef CONFIG_EPOLL_EDGE_TRIGGERED
+			else
+			{
+				// both directions can be signaled by one edge
+				if(m_rEvents[i].events & EPOLLIN)
+				{
+					/* Len is unknown at this point. */
+					startTime = SocketMetrics::GetTime();
+					pSocket->ReadCallback(0);
+					rMetrics.Record(SOCKET_HISTOGRAM_READ_LATENCY, SocketMetrics::GetTime() - startTime);
+				}
+				
+				if((m_rEvents[i].events & EPOLLOUT) && pSocket->IsConnected())
+				{
+					startTime = SocketMetrics::GetTime();
+					pSocket->BurstBegin();					//lock
+					pSocket->WriteCallback(0);				//send until EAGAIN
+					pSocket->BurstEnd();					//Unlock
+					rMetrics.Record(SOCKET_HISTOGRAM_WRITE_LATENCY, SocketMetrics::GetTime() - startTime);
+				}
+			}
+#else
 			else if(m_rEvents[i].events & EPOLLIN)
 			{
 				/* Len is unknown at this point. */
+				startTime = SocketMetrics::GetTime();
 				pSocket->ReadCallback(0);
-				
+				rMetrics.Record(SOCKET_HISTOGRAM_READ_LATENCY, SocketMetrics::GetTime() - startTime);
 			}
 			else if(m_rEvents[i].events & EPOLLOUT)
 			{
+				startTime = SocketMetrics::GetTime();
 				pSocket->BurstBegin();						//lock
 				pSocket->WriteCallback(0);					//perform send
                 if(pSocket->IsConnected())
@@ -160,8 +377,19 @@ bool SocketWorkerThread::run()
                     }
                 }
 				pSocket->BurstEnd(); 						//Unlock
+				rMetrics.Record(SOCKET_HISTOGRAM_WRITE_LATENCY, SocketMetrics::GetTime() - startTime);
 			}
+#endif
+        }
+        
+        //full batch - more events are probably ready, take them in one call next time
+        if(fd_count == static_cast<int>(m_rEvents.size()) && m_rEvents.size() < MAX_EVENTS_LIMIT)
+        {
+            m_rEvents.resize(std::min<size_t>(m_rEvents.size() * 2, MAX_EVENTS_LIMIT));
         }
+        
+        //idle timeouts, deferred deletion
+        m_pReactor->UpdateTimers();
     }
     return true;
 }
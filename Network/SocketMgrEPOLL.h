@@ -28,31 +28,128 @@ class Socket;
 class SocketWorkerThread;
 class ListenSocketBase;
 
-typedef std::set<BaseSocket*>			SocketSet;
+/// one epoll instance serviced by exactly one SocketWorkerThread
+class SocketReactor
+{
+public:
+    /// constructor > create epoll device handle
+    explicit SocketReactor(uint32 id);
+    
+    /// destructor > destroy epoll handle, deletes sockets waiting for deletion
+    ~SocketReactor();
+    
+    /// reactor index inside SocketMgr
+    uint32 GetId() const        { return m_id; }
+    
+    /// epoll fd
+    int GetEpollFd() const      { return m_epoll_fd; }
+    
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+    /// chunk pool shared by buffers of sockets on this reactor
+    SocketBufferPool * GetBufferPool()  { return &m_rBufferPool; }
+#endif
+    
+    /// eventfd waking up reactor thread
+    int GetWakeupFd() const     { return m_wakeup_fd; }
+    
+    /// schedules flush of socket's outbound queue on reactor thread - any thread
+    void ScheduleSend(SocketPendingNode * pNode);
+    
+    /// flushes outbound queues of scheduled sockets - reactor thread
+    void ProcessPendingSends();
+    
+    /// schedules update of socket's timer on reactor thread - any thread
+    void ScheduleTimer(SocketPendingNode * pNode);
+    
+    /// updates timers of scheduled sockets - reactor thread
+    void ProcessPendingTimers();
+    
+    /// timer wheel - reactor thread only
+    TimerWheel & GetTimers()    { return m_rTimers; }
+    
+    /// time of current loop iteration in ms - reactor thread
+    uint64 GetTime() const      { return m_now; }
+    
+    /// refreshes time of loop iteration - reactor thread
+    void RefreshTime()          { m_now = GetTickCount64(); }
+    
+    /// fires expired timers - reactor thread
+    void UpdateTimers()         { m_rTimers.Advance(m_now); }
+    
+    /// reactor is being destroyed - timers only finish deferred deletions
+    bool IsShuttingDown() const { return m_shutdown; }
+    
+    /// epoll_wait timeout in ms, bounded by next timer
+    int GetWaitTimeout() const;
+    
+    /// spin budget in us before blocking in epoll_wait, 0 = block immediately - any thread
+    void SetBusyPoll(uint32 busyPoll)   { m_busyPoll = busyPoll; }
+    uint32 GetBusyPoll() const          { return m_busyPoll; }
+    
+    /// binds reactor to calling worker thread - reactor thread
+    void SetOwnerThread()       { m_ownerThread.store(std::this_thread::get_id(), std::memory_order_relaxed); }
+    
+    /// true if called from reactor's worker thread - any thread
+    bool IsOwnerThread() const  { return m_ownerThread.load(std::memory_order_relaxed) == std::this_thread::get_id(); }
+    
+    /// counters and histograms of this reactor
+    SocketMetrics & GetMetrics()    { return m_rMetrics; }
+    const SocketMetrics & GetMetrics() const    { return m_rMetrics; }
+    
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(SocketReactor);
+    
+    uint32              m_id;
+    int                 m_epoll_fd;
+    int                 m_wakeup_fd;
+    
+    /// sockets with frames queued by QueueSend
+    MPSCQueue<SocketPendingNode>    m_pendingSends;
+    std::atomic<bool>               m_wakeupPending;
+    
+    /// sockets requesting timer update (connect, idle timeout change, deletion)
+    MPSCQueue<SocketPendingNode>    m_pendingTimers;
+    
+    /// idle timeouts, deferred deletion
+    uint64              m_now;
+    TimerWheel          m_rTimers;
+    bool                m_shutdown;
+    
+    SocketMetrics       m_rMetrics;
+    std::atomic<std::thread::id>    m_ownerThread;
+    std::atomic<uint32> m_busyPoll;
+#ifdef CONFIG_SOCKET_CHUNKED_BUFFERS
+    SocketBufferPool    m_rBufferPool;
+#endif
+};
+
+typedef std::vector<SocketReactor*>				SocketReactorVec;
 
 class SocketMgr : public Singleton<SocketMgr>
 {
 private:
-    /// /dev/epoll instance handle
-    int 				m_epoll_fd;
+    /// epoll reactors, socket stays on one reactor for its whole lifetime
+    SocketReactorVec        m_reactors;
+    std::atomic<uint32>     m_nextReactor;
 
-    // fd -> pointer binding.
-	volatile SocketSet	m_sockets;
-	std::mutex			m_socketLock;
+    /// registered sockets, slot param is socket's reactor
+    SocketTable             m_sockets;
 
 public:
 
     /// friend class of the worker thread -> it has to access our private resources
     friend class SocketWorkerThread;
 
-	/// constructor > create epoll device handle
-	explicit SocketMgr();
+	/// constructor > create epoll reactors
+	explicit SocketMgr(uint32 reactorCount = SOCKET_REACTOR_COUNT);
 	
-    /// destructor > destroy epoll handle
+    /// destructor > destroy epoll reactors
     ~SocketMgr();
 
     /// add a new socket to the epoll set and to the fd mapping
-    void AddSocket(BaseSocket * pSocket, bool listenSocket);
+    /// if pReactor is NULL socket is assigned to reactor in round robin
+    void AddSocket(BaseSocket * pSocket, bool listenSocket, SocketReactor * pReactor = NULL);
 
     /// remove a socket from epoll set/fd mapping
     void RemoveSocket(BaseSocket * pSocket);
@@ -63,24 +160,51 @@ public:
 	//
 	void WantRead(BaseSocket * pSocket);	
 
-    /// closes all sockets
+    /// closes all sockets, waits until all of them are removed
     void CloseAll();
-
-    /// spawns worker threads
+    
+    /// calls f(BaseSocket*) for every registered socket without locking - broadcasts
+    template<class F>
+    void ForEachSocket(F f) const               { m_sockets.ForEach(f); }
+    
+    /// number of registered sockets
+    size_t GetSocketCount() const               { return m_sockets.GetCount(); }
+
+    /// spawns one worker thread per reactor
     void SpawnWorkerThreads();
-		
-	//epoll fd
-	int GetEpollFd() const  { return m_epoll_fd; }
+    
+    /// returns next reactor in round robin order
+    SocketReactor * GetNextReactor();
+    
+    /// number of reactors
+    uint32 GetReactorCount() const      { return static_cast<uint32>(m_reactors.size()); }
+    
+    /// reactor by index
+    SocketReactor * GetReactor(uint32 id) const     { return m_reactors[id]; }
+    
+    /// sets spin budget in us of all reactors - latency vs CPU usage
+    void SetBusyPoll(uint32 busyPoll);
+    
+    /// aggregates metrics of all reactors into snapshot - any thread
+    void GetMetrics(SocketMetricsSnapshot & rSnapshot) const;
 };
 
 class SocketWorkerThread : public ThreadContext
 {
 public:
+    explicit SocketWorkerThread(SocketReactor * pReactor) : m_pReactor(pReactor), m_rEvents(MAX_EVENTS)
+    {
+    }
+    
     //ThreadContext
     bool run();
 
 private:
-    struct epoll_event m_rEvents[MAX_EVENTS];
+    /// spins for busy poll budget, then blocks until event or next timer
+    int Wait();
+    
+    SocketReactor                   *m_pReactor;
+    std::vector<struct epoll_event> m_rEvents;      //grows when epoll_wait returns full batch
 };
 
 #define sSocketMgr SocketMgr::getSingleton()
@@ -95,10 +95,7 @@ void HandleWriteComplete(Socket * s, size_t len)
 		s->GetWriteEvent().Unmark();
 		s->BurstBegin();					// Lock
 		s->GetWriteBuffer().Remove(len);
-		if(s->GetWriteBuffer().GetContiguiousBytes() > 0)
-			s->WriteCallback(len);
-		else
-			s->DecSendLock();
+		s->WriteCallback(len);				// next part or release of send lock
 		s->BurstEnd();						// Unlock
 	}
 }
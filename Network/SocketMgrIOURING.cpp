@@ -0,0 +1,505 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+#ifdef CONFIG_USE_IO_URING
+
+initialiseSingleton(SocketMgr);
+
+SocketMgr::SocketMgr() : m_sqTail(0), m_bufTail(0), m_wakeupValue(0), m_wakeupPending(false), m_wakeupEvent(SOCKET_IO_EVENT_WAKEUP, this), m_shutdown(false)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+
+	m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, SOCKET_URING_ENTRIES, &params));
+	if(m_ringFd < 0 && errno == EINVAL)
+	{
+		//older kernel without setup flags
+		memset(&params, 0, sizeof(params));
+		m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, SOCKET_URING_ENTRIES, &params));
+	}
+
+	if(m_ringFd < 0)
+	{
+		Log.Error(__FUNCTION__, "Could not create io_uring, errno %u (%s).", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+	{
+		Log.Error(__FUNCTION__, "io_uring is too old (single mmap and nodrop features are required).");
+		exit(EXIT_FAILURE);
+	}
+
+	//SQ and CQ rings share one mapping
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	m_ringSize = std::max(sqSize, cqSize);
+	m_pRing = static_cast<uint8*>(mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING));
+
+	m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	m_pSqes = static_cast<struct io_uring_sqe*>(mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES));
+
+	if(m_pRing == MAP_FAILED || m_pSqes == MAP_FAILED)
+	{
+		Log.Error(__FUNCTION__, "Could not map io_uring, errno %u (%s).", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	m_pSqHead	= reinterpret_cast<uint32*>(m_pRing + params.sq_off.head);
+	m_pSqTail	= reinterpret_cast<uint32*>(m_pRing + params.sq_off.tail);
+	m_sqMask	= *reinterpret_cast<uint32*>(m_pRing + params.sq_off.ring_mask);
+	m_sqEntries	= params.sq_entries;
+	m_sqTail	= *m_pSqTail;
+
+	//SQ index array maps 1:1 to SQEs
+	uint32 *pArray = reinterpret_cast<uint32*>(m_pRing + params.sq_off.array);
+	for(uint32 i = 0;i < m_sqEntries;++i)
+	{
+		pArray[i] = i;
+	}
+
+	m_pCqHead	= reinterpret_cast<uint32*>(m_pRing + params.cq_off.head);
+	m_pCqTail	= reinterpret_cast<uint32*>(m_pRing + params.cq_off.tail);
+	m_cqMask	= *reinterpret_cast<uint32*>(m_pRing + params.cq_off.ring_mask);
+	m_pCqes		= reinterpret_cast<struct io_uring_cqe*>(m_pRing + params.cq_off.cqes);
+
+	//provided buffer ring for multishot recv
+	m_pBufRing = static_cast<struct io_uring_buf*>(mmap(NULL, SOCKET_URING_BUFFER_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	m_pBuffers = static_cast<uint8*>(_MALLOC(static_cast<size_t>(SOCKET_URING_BUFFER_COUNT) * SOCKET_URING_BUFFER_SIZE));
+	if(m_pBufRing == MAP_FAILED || m_pBuffers == NULL)
+	{
+		Log.Error(__FUNCTION__, "Could not allocate provided buffers.");
+		exit(EXIT_FAILURE);
+	}
+
+	//tail overlays resv field of first buffer
+	m_pBufRingTail = &reinterpret_cast<struct io_uring_buf_ring*>(m_pBufRing)->tail;
+
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr		= reinterpret_cast<uint64>(m_pBufRing);
+	reg.ring_entries	= SOCKET_URING_BUFFER_COUNT;
+	reg.bgid			= 0;
+	if(syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+	{
+		Log.Error(__FUNCTION__, "Could not register provided buffer ring, errno %u (%s).", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	for(uint32 i = 0;i < SOCKET_URING_BUFFER_COUNT;++i)
+	{
+		RecycleBuffer(static_cast<uint16>(i));
+	}
+
+	//eventfd is blocking - io_uring polls it instead of returning EAGAIN
+	m_wakeupFd = eventfd(0, EFD_CLOEXEC);
+	if(m_wakeupFd == -1)
+	{
+		Log.Error(__FUNCTION__, "Could not create wakeup eventfd.");
+		exit(EXIT_FAILURE);
+	}
+	PrepareWakeup();
+}
+
+SocketMgr::~SocketMgr()
+{
+	close(m_wakeupFd);
+	munmap(m_pBufRing, SOCKET_URING_BUFFER_COUNT * sizeof(struct io_uring_buf));
+	munmap(m_pSqes, m_sqesSize);
+	munmap(m_pRing, m_ringSize);
+	close(m_ringFd);
+	_FREE(m_pBuffers);
+}
+
+void SocketMgr::SpawnWorkerThreads()
+{
+    ThreadPool.ExecuteTask(new SocketWorkerThread());
+}
+
+struct io_uring_sqe * SocketMgr::GetSqe()
+{
+	ReserveSqes(1);
+
+	struct io_uring_sqe *pSqe = &m_pSqes[m_sqTail & m_sqMask];
+	memset(pSqe, 0, sizeof(struct io_uring_sqe));
+	++m_sqTail;
+	return pSqe;
+}
+
+void SocketMgr::ReserveSqes(uint32 count)
+{
+	//not enough free entries - let kernel consume SQ
+	while(m_sqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) + count > m_sqEntries)
+	{
+		__atomic_store_n(m_pSqTail, m_sqTail, __ATOMIC_RELEASE);
+		if(syscall(__NR_io_uring_enter, m_ringFd, m_sqTail - *m_pSqHead, 0, 0, NULL, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			Log.Error(__FUNCTION__, "io_uring_enter failed, errno %u (%s)", errno, strerror(errno));
+			break;
+		}
+	}
+}
+
+void SocketMgr::RecycleBuffer(uint16 bid)
+{
+	uint32 mask = SOCKET_URING_BUFFER_COUNT - 1;
+	struct io_uring_buf *pBuf = &m_pBufRing[m_bufTail & mask];
+	pBuf->addr	= reinterpret_cast<uint64>(GetBuffer(bid));
+	pBuf->len	= SOCKET_URING_BUFFER_SIZE;
+	pBuf->bid	= bid;
+	++m_bufTail;
+
+	//publish
+	__atomic_store_n(m_pBufRingTail, m_bufTail, __ATOMIC_RELEASE);
+}
+
+void SocketMgr::PrepareRecv(Socket * s)
+{
+	//already armed
+	if(s->GetReadEvent().m_pending != 0)
+		return;
+
+	struct io_uring_sqe *pSqe = GetSqe();
+	pSqe->opcode	= IORING_OP_RECV;
+	pSqe->fd		= s->GetFd();
+	pSqe->ioprio	= IORING_RECV_MULTISHOT;
+	pSqe->flags		= IOSQE_BUFFER_SELECT;
+	pSqe->buf_group	= 0;
+	pSqe->user_data	= reinterpret_cast<uint64>(&s->GetReadEvent());
+	++s->GetReadEvent().m_pending;
+}
+
+void SocketMgr::PrepareAccept(ListenSocketBase * pListenSocket)
+{
+	struct io_uring_sqe *pSqe = GetSqe();
+	pSqe->opcode		= IORING_OP_ACCEPT;
+	pSqe->fd			= pListenSocket->GetFd();
+	pSqe->ioprio		= IORING_ACCEPT_MULTISHOT;
+	pSqe->accept_flags	= SOCK_CLOEXEC;
+	pSqe->user_data		= reinterpret_cast<uint64>(&pListenSocket->GetAcceptEvent());
+	++pListenSocket->GetAcceptEvent().m_pending;
+}
+
+void SocketMgr::PrepareWakeup()
+{
+	struct io_uring_sqe *pSqe = GetSqe();
+	pSqe->opcode	= IORING_OP_READ;
+	pSqe->fd		= m_wakeupFd;
+	pSqe->addr		= reinterpret_cast<uint64>(&m_wakeupValue);
+	pSqe->len		= sizeof(m_wakeupValue);
+	pSqe->user_data	= reinterpret_cast<uint64>(&m_wakeupEvent);
+}
+
+void SocketMgr::AddListenSocket(ListenSocketBase * pListenSocket)
+{
+	m_listenLock.lock();
+	m_pendingListenSockets.push_back(pListenSocket);
+	m_listenLock.unlock();
+	Wakeup();
+}
+
+void SocketMgr::ResetWakeup()
+{
+	m_wakeupPending = false;
+	PrepareWakeup();
+}
+
+void SocketMgr::ScheduleRequest(SocketRequestNode * pNode)
+{
+	m_requests.push(pNode);
+	Wakeup();
+}
+
+void SocketMgr::Wakeup()
+{
+	//worker is woken once per batch, flag is reset by wakeup completion
+	if(!m_wakeupPending.exchange(true))
+	{
+		uint64 value = 1;
+		if(write(m_wakeupFd, &value, sizeof(value)) < 0)
+		{
+			Log.Warning(__FUNCTION__, "Could not signal worker, errno %u", errno);
+		}
+	}
+}
+
+void SocketMgr::ProcessRequests()
+{
+	m_listenLock.lock();
+	for(std::vector<ListenSocketBase*>::iterator itr = m_pendingListenSockets.begin();itr != m_pendingListenSockets.end();++itr)
+	{
+		PrepareAccept(*itr);
+	}
+	m_pendingListenSockets.clear();
+	m_listenLock.unlock();
+
+	SocketRequestNode *pNode;
+	while((pNode = m_requests.pop()) != NULL)
+	{
+		Socket *s = pNode->m_pSocket;
+		uint32 requests = s->TakeRequests();
+
+		if((requests & SOCKET_REQUEST_RECV) && s->IsConnected())
+		{
+			PrepareRecv(s);
+		}
+
+		if(requests & SOCKET_REQUEST_SEND)
+		{
+			s->BurstBegin();
+			if(s->IsConnected())
+			{
+				s->WriteCallback(0);
+			}
+			else
+			{
+				s->DecSendLock();
+			}
+			s->BurstEnd();
+		}
+
+		//after operations above - fd lookup of SQEs is done in order on submit
+		if(requests & SOCKET_REQUEST_CLOSE)
+		{
+			struct io_uring_sqe *pSqe = GetSqe();
+			pSqe->opcode	= IORING_OP_CLOSE;
+			pSqe->fd		= s->GetFd();
+			pSqe->user_data	= 0;
+		}
+	}
+}
+
+void SocketMgr::SubmitAndWait()
+{
+	__atomic_store_n(m_pSqTail, m_sqTail, __ATOMIC_RELEASE);
+	uint32 toSubmit = m_sqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+
+	//completions already waiting - only submit
+	uint32 waitFor = (__atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE) != *m_pCqHead) ? 0 : 1;
+	if(toSubmit == 0 && waitFor == 0)
+		return;
+
+	if(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0)
+	{
+		if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			Log.Error(__FUNCTION__, "io_uring_enter failed, errno %u (%s)", errno, strerror(errno));
+		}
+	}
+}
+
+bool SocketMgr::PopCompletion(struct io_uring_cqe & rCqe)
+{
+	uint32 head = *m_pCqHead;
+	if(head == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE))
+		return false;
+
+	rCqe = m_pCqes[head & m_cqMask];
+	__atomic_store_n(m_pCqHead, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool SocketWorkerThread::run()
+{
+    CommonFunctions::SetThreadName("SocketWorker thread");
+    //
+	struct io_uring_cqe rCqe;
+	UringOperation * pOp;
+
+	while(!sSocketMgr.IsShutdown())
+	{
+		//prepare queued sends etc. and submit them with wait in one syscall
+		sSocketMgr.ProcessRequests();
+		sSocketMgr.SubmitAndWait();
+
+		while(sSocketMgr.PopCompletion(rCqe))
+		{
+			pOp = reinterpret_cast<UringOperation*>(rCqe.user_data);
+			if(pOp == NULL)
+				continue;
+
+			//final completion of operation
+			if(!(rCqe.flags & IORING_CQE_F_MORE))
+			{
+				--pOp->m_pending;
+			}
+
+			if(pOp->m_event < NUM_SOCKET_IO_EVENTS)
+			{
+				g_ophandlers[pOp->m_event](pOp, rCqe.res, rCqe.flags);
+			}
+		}
+	}
+	return true;
+}
+
+void HandleAccept(UringOperation * pOp, int32 res, uint32 /*flags*/)
+{
+	ListenSocketBase *pListenSocket = static_cast<ListenSocketBase*>(pOp->m_pOwner);
+	if(res >= 0)
+	{
+		if(pListenSocket->IsOpen())
+		{
+			pListenSocket->OnAccept(static_cast<SOCKET>(res));
+		}
+		else
+		{
+			SocketOps::CloseSocket(static_cast<SOCKET>(res));
+		}
+	}
+	else if(res != -ECONNABORTED && pListenSocket->IsOpen())
+	{
+		Log.Error(__FUNCTION__, "accept failed on fd %u, errno %u (%s)", pListenSocket->GetFd(), -res, strerror(-res));
+	}
+
+	//multishot accept was terminated - rearm
+	if(pOp->m_pending == 0 && pListenSocket->IsOpen())
+	{
+		sSocketMgr.PrepareAccept(pListenSocket);
+	}
+}
+
+void HandleReadComplete(UringOperation * pOp, int32 res, uint32 flags)
+{
+	Socket *s = static_cast<Socket*>(pOp->m_pOwner);
+	if(res > 0 && (flags & IORING_CQE_F_BUFFER))
+	{
+		uint16 bid = static_cast<uint16>(flags >> IORING_CQE_BUFFER_SHIFT);
+		if(!s->IsDeleted())
+		{
+			//give consumer chance to free buffer
+			if(!s->GetReadBuffer().Write(sSocketMgr.GetBuffer(bid), res))
+			{
+				s->ReadCallback(0);
+				if(s->IsConnected() && !s->GetReadBuffer().Write(sSocketMgr.GetBuffer(bid), res))
+				{
+					Log.Error(__FUNCTION__, "Read buffer full on fd %u, disconnecting", s->GetFd());
+					s->Disconnect();
+				}
+			}
+			else
+			{
+				s->ReadCallback(res);
+			}
+		}
+		sSocketMgr.RecycleBuffer(bid);
+	}
+	else if(res == -ENOBUFS)
+	{
+		//all provided buffers were in use, they are already recycled
+	}
+	else if(!s->IsDeleted())
+	{
+		if(res == 0)
+			s->Delete();	  // Queue deletion.
+		else
+			s->OnError(-res);
+	}
+
+	//multishot recv was terminated - rearm
+	if(pOp->m_pending == 0 && s->IsConnected())
+	{
+		sSocketMgr.PrepareRecv(s);
+	}
+}
+
+void HandleWriteComplete(UringOperation * pOp, int32 res, uint32 /*flags*/)
+{
+	Socket *s = static_cast<Socket*>(pOp->m_pOwner);
+	if(s->IsDeleted())
+		return;
+
+	s->BurstBegin();					// Lock
+	if(res > 0)
+	{
+		s->GetWriteBuffer().Remove(res);
+	}
+
+	//-ECANCELED is linked send after failed one
+	if(res < 0 && res != -ECANCELED && s->IsConnected())
+	{
+		s->BurstEnd();					// Unlock
+		s->OnError(-res);
+		return;
+	}
+
+	//all linked sends finished
+	if(pOp->m_pending == 0)
+	{
+		if(s->IsConnected())
+			s->WriteCallback(res);		// next batch or release send lock
+		else
+			s->DecSendLock();
+	}
+	s->BurstEnd();						// Unlock
+}
+
+void HandleWakeup(UringOperation * /*pOp*/, int32 /*res*/, uint32 /*flags*/)
+{
+	//reset before rearm - request pushed after this point signals again
+	sSocketMgr.ResetWakeup();
+}
+
+void SocketMgr::AddSocket(Socket *s)
+{
+	if(s->GetHandle() != 0)
+		return;
+	
+	SocketHandle handle = m_sockets.Add(s, NULL);
+	if(handle != 0 && s->ExchangeHandle(handle) != 0)
+	{
+		m_sockets.Remove(handle);
+	}
+}
+
+void SocketMgr::RemoveSocket(Socket *s)
+{
+	SocketHandle handle = s->ExchangeHandle(0);
+	if(handle != 0)
+	{
+		m_sockets.Remove(handle);
+	}
+}
+
+void SocketMgr::CloseAll()
+{
+	std::list<BaseSocket*> tokill;
+	m_sockets.GetSockets(tokill);
+	
+	for(std::list<BaseSocket*>::iterator itr = tokill.begin(); itr != tokill.end(); ++itr)
+	{
+		(*itr)->Disconnect();
+	}
+
+	//Disconnect removes socket from table
+	m_sockets.WaitEmpty();
+}
+
+void SocketMgr::ShutdownThreads()
+{
+	m_shutdown = true;
+	m_wakeupPending = false;
+	Wakeup();
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SOCKETMGR_URING_H
+#define SOCKETMGR_URING_H
+
+#include "SocketDefines.h"
+
+#ifdef CONFIG_USE_IO_URING
+
+class Socket;
+class ListenSocketBase;
+
+/// one io_uring instance serviced by one SocketWorkerThread.
+/// Other threads never touch the ring - they queue requests and wake the worker by eventfd.
+class SocketMgr : public Singleton<SocketMgr>
+{
+public:
+	/// constructor > create ring and register provided buffer ring
+	SocketMgr();
+	
+	/// destructor > destroy ring
+	~SocketMgr();
+
+	void SpawnWorkerThreads();
+	void CloseAll();
+
+	void AddSocket(Socket * s);
+	void RemoveSocket(Socket * s);
+
+	/// calls f(BaseSocket*) for every registered socket without locking - broadcasts
+	template<class F>
+	void ForEachSocket(F f) const		{ m_sockets.ForEach(f); }
+
+	/// number of registered sockets
+	size_t GetSocketCount() const		{ return m_sockets.GetCount(); }
+
+	/// arms multishot accept - any thread
+	void AddListenSocket(ListenSocketBase * pListenSocket);
+
+	/// queues socket with requests for worker thread - any thread
+	void ScheduleRequest(SocketRequestNode * pNode);
+
+	/// stops worker thread
+	void ShutdownThreads();
+
+	/// returns free SQE, flushes ring when full - worker thread
+	struct io_uring_sqe * GetSqe();
+
+	/// flushes ring until count SQEs are free, next count GetSqe calls do not submit - worker thread
+	void ReserveSqes(uint32 count);
+
+	/// returns provided buffer to ring - worker thread
+	void RecycleBuffer(uint16 bid);
+
+	/// data of provided buffer
+	uint8 * GetBuffer(uint16 bid)	{ return m_pBuffers + static_cast<size_t>(bid) * SOCKET_URING_BUFFER_SIZE; }
+
+	/// arms multishot recv - worker thread
+	void PrepareRecv(Socket * s);
+
+	/// arms multishot accept - worker thread
+	void PrepareAccept(ListenSocketBase * pListenSocket);
+
+	/// arms eventfd read - worker thread
+	void PrepareWakeup();
+
+	/// wakeup was consumed, next request signals eventfd again - worker thread
+	void ResetWakeup();
+
+	/// executes queued requests - worker thread
+	void ProcessRequests();
+
+	/// submits SQEs and waits for at least one completion in one syscall - worker thread
+	void SubmitAndWait();
+
+	/// pops completion, returns false if CQ is empty - worker thread
+	bool PopCompletion(struct io_uring_cqe & rCqe);
+
+	/// worker thread should exit
+	bool IsShutdown() const		{ return m_shutdown; }
+
+private:
+	//disable copy constructor and assign
+	DISALLOW_COPY_AND_ASSIGN(SocketMgr);
+
+	/// wakes worker blocked in io_uring_enter
+	void Wakeup();
+
+	SocketTable			m_sockets;
+
+	/// ring fd and mmaped rings
+	int					m_ringFd;
+	uint8				*m_pRing;
+	size_t				m_ringSize;
+	struct io_uring_sqe	*m_pSqes;
+	size_t				m_sqesSize;
+
+	/// submission queue, m_sqTail is local copy published on submit
+	uint32				*m_pSqHead;
+	uint32				*m_pSqTail;
+	uint32				m_sqMask;
+	uint32				m_sqEntries;
+	uint32				m_sqTail;
+
+	/// completion queue
+	uint32				*m_pCqHead;
+	uint32				*m_pCqTail;
+	uint32				m_cqMask;
+	struct io_uring_cqe	*m_pCqes;
+
+	/// provided buffers for multishot recv (group 0)
+	/// ring is accessed as plain io_uring_buf array, flexible array of io_uring_buf_ring has different offset in C++
+	struct io_uring_buf	*m_pBufRing;
+	uint16				*m_pBufRingTail;
+	uint8				*m_pBuffers;
+	uint16				m_bufTail;
+
+	/// listen sockets waiting for accept arming
+	std::mutex			m_listenLock;
+	std::vector<ListenSocketBase*>	m_pendingListenSockets;
+
+	/// sockets with requests, eventfd wakeup
+	MPSCQueue<SocketRequestNode>	m_requests;
+	int					m_wakeupFd;
+	uint64				m_wakeupValue;
+	std::atomic<bool>	m_wakeupPending;
+	UringOperation		m_wakeupEvent;
+	std::atomic<bool>	m_shutdown;
+};
+
+#define sSocketMgr SocketMgr::getSingleton()
+
+typedef void(*OperationHandler)(UringOperation * pOp, int32 res, uint32 flags);
+
+class SocketWorkerThread : public ThreadContext
+{
+public:
+	bool run();
+};
+
+void HandleAccept(UringOperation * pOp, int32 res, uint32 flags);
+void HandleReadComplete(UringOperation * pOp, int32 res, uint32 flags);
+void HandleWriteComplete(UringOperation * pOp, int32 res, uint32 flags);
+void HandleWakeup(UringOperation * pOp, int32 res, uint32 flags);
+
+static const OperationHandler g_ophandlers[NUM_SOCKET_IO_EVENTS] =
+{
+	&HandleAccept,
+	&HandleReadComplete,
+	&HandleWriteComplete,
+	&HandleWakeup,
+};
+
+#endif
+#endif
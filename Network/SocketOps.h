@@ -55,6 +55,12 @@ namespace SocketOps
     
     // Sets SO_KEEPALIVE
     void KeepAlive(SOCKET fd);
+
+	// Sets SO_REUSEPORT - more listen sockets on same port (kernel balances connections)
+	bool ReusePort(SOCKET fd);
+
+	// Sets TCP_DEFER_ACCEPT - accept is signaled when data arrives, timeout in seconds
+	bool DeferAccept(SOCKET fd, uint32 timeout);
 }
 
 #endif
@@ -21,6 +21,11 @@
 
 #if !defined(WIN32)
 
+//netinet/tcp.h is not included (TCP_NODELAY is defined in SocketDefines.h)
+#if defined(__linux__) && !defined(TCP_DEFER_ACCEPT)
+    #define TCP_DEFER_ACCEPT 9
+#endif
+
 namespace SocketOps
 {
     // Create file descriptor for socket i/o operations.
@@ -99,6 +104,28 @@ namespace SocketOps
         uint32 option = 1;
         setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &option, sizeof(option));
     }
+
+    // Sets reuseport
+    bool ReusePort(SOCKET fd)
+    {
+#ifdef SO_REUSEPORT
+        int option = 1;
+        return (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) == 0);
+#else
+        return false;
+#endif
+    }
+
+    // Sets defer accept
+    bool DeferAccept(SOCKET fd, uint32 timeout)
+    {
+#ifdef TCP_DEFER_ACCEPT
+        int option = static_cast<int>(timeout);
+        return (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &option, sizeof(option)) == 0);
+#else
+        return false;
+#endif
+    }
 }
 
 #endif
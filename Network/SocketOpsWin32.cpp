@@ -100,6 +100,18 @@ namespace SocketOps
 		uint32 option = 1;
 		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (const char*)&option, sizeof(option));
 	}
+
+	// Not supported on windows
+	bool ReusePort(SOCKET fd)
+	{
+		return false;
+	}
+
+	// Not supported on windows
+	bool DeferAccept(SOCKET fd, uint32 timeout)
+	{
+		return false;
+	}
 }
 
 #endif
@@ -50,6 +50,7 @@ Socket::Socket(SOCKET fd, size_t readbuffersize, size_t writebuffersize) : m_rea
     SocketOps::SetTimeout(m_fd, SOCKET_SEND_RECV_TIMEOUT);
 
 	m_writeLock     = 0;
+	m_disconnectAfterSend = false;
 	m_deleted       = false;
 	m_connected     = false;
 }
@@ -157,6 +158,11 @@ void Socket::WriteCallback(size_t len)
 	}
 
 	m_writeBuffer.Remove(bytes);
+	
+	if(m_disconnectAfterSend && !Writable())
+	{
+		Disconnect();
+	}
 }
 
 bool Socket::BurstSend(const void * data, size_t bytes)
@@ -204,6 +210,22 @@ void Socket::Delete()
 	sSocketGarbageCollector.QueueSocket(this);
 }
 
+void Socket::DisconnectAfterSend()
+{
+	BurstBegin();
+	bool pending = Writable();
+	if(pending)
+	{
+		m_disconnectAfterSend = true;
+	}
+	BurstEnd();
+	
+	if(!pending)
+	{
+		Disconnect();
+	}
+}
+
 void Socket::OnError(int errcode)
 {
 	Log.Debug(__FUNCTION__, "Error number: %u", errcode);
@@ -67,6 +67,10 @@ public:
 	*/
 	void Delete();
 
+	/** Disconnects the socket once everything in write buffer is sent (response with Connection: close)
+	*/
+	void DisconnectAfterSend();
+
 	/** Implemented ReadCallback()
 	*/
 	void ReadCallback(size_t len);
@@ -158,6 +162,10 @@ protected:
 	/** Write lock, stops multiple write events from being posted.
 	*/
 	std::atomic<long>	m_writeLock;
+
+	/** WriteCallback disconnects when write buffer is flushed - guarded by m_writeMutex
+	*/
+	bool				m_disconnectAfterSend;
 };
 
 #endif
@@ -0,0 +1,183 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+SocketTable::SocketTable() : m_nextShard(0), m_count(0)
+{
+
+}
+
+SocketTable::~SocketTable()
+{
+    for(uint32 shard = 0;shard < SOCKET_TABLE_SHARDS;++shard)
+    {
+        for(uint32 i = 0;i < SOCKET_TABLE_MAX_CHUNKS;++i)
+        {
+            SocketSlot *pChunk = m_rShards[shard].m_pChunks[i].load(std::memory_order_relaxed);
+            if(pChunk == NULL)
+                break;
+            
+            delete [] pChunk;
+        }
+    }
+}
+
+SocketSlot * SocketTable::GetSlot(uint32 shard, uint32 index) const
+{
+    SocketSlot *pChunk = m_rShards[shard].m_pChunks[index / SOCKET_TABLE_CHUNK_SIZE].load(std::memory_order_acquire);
+    return &pChunk[index % SOCKET_TABLE_CHUNK_SIZE];
+}
+
+SocketHandle SocketTable::Add(BaseSocket * pSocket, void * pParam)
+{
+    uint32 shard = m_nextShard++ & (SOCKET_TABLE_SHARDS - 1);
+    SocketShard & rShard = m_rShards[shard];
+    
+    std::lock_guard<std::mutex> rGuard(rShard.m_lock);
+    
+    uint32 index;
+    SocketSlot *pSlot;
+    if(!rShard.m_freeSlots.empty())
+    {
+        index = rShard.m_freeSlots.back();
+        rShard.m_freeSlots.pop_back();
+        pSlot = GetSlot(shard, index);
+    }
+    else
+    {
+        index = rShard.m_size.load(std::memory_order_relaxed);
+        if(index / SOCKET_TABLE_CHUNK_SIZE >= SOCKET_TABLE_MAX_CHUNKS)
+        {
+            Log.Error(__FUNCTION__, "Socket table shard %u is full", shard);
+            return 0;
+        }
+        
+        //new chunk
+        if(index % SOCKET_TABLE_CHUNK_SIZE == 0 && rShard.m_pChunks[index / SOCKET_TABLE_CHUNK_SIZE].load(std::memory_order_relaxed) == NULL)
+        {
+            SocketSlot *pChunk = new SocketSlot[SOCKET_TABLE_CHUNK_SIZE];
+            for(uint32 i = 0;i < SOCKET_TABLE_CHUNK_SIZE;++i)
+            {
+                pChunk[i].m_pSocket.store(NULL, std::memory_order_relaxed);
+                pChunk[i].m_generation.store(1, std::memory_order_relaxed);
+                pChunk[i].m_pParam = NULL;
+            }
+            rShard.m_pChunks[index / SOCKET_TABLE_CHUNK_SIZE].store(pChunk, std::memory_order_release);
+        }
+        
+        pSlot = GetSlot(shard, index);
+    }
+    
+    pSlot->m_pParam = pParam;
+    pSlot->m_pSocket.store(pSocket, std::memory_order_release);
+    
+    //publish new slot for ForEach
+    if(index >= rShard.m_size.load(std::memory_order_relaxed))
+    {
+        rShard.m_size.store(index + 1, std::memory_order_release);
+    }
+    
+    ++m_count;
+    
+    uint64 generation = pSlot->m_generation.load(std::memory_order_relaxed);
+    return (generation << 32) | (static_cast<uint64>(index) << SOCKET_TABLE_SHARD_BITS) | shard;
+}
+
+bool SocketTable::Remove(SocketHandle handle, void ** ppParam)
+{
+    uint32 generation = static_cast<uint32>(handle >> 32);
+    uint32 shard = static_cast<uint32>(handle) & (SOCKET_TABLE_SHARDS - 1);
+    uint32 index = static_cast<uint32>(handle) >> SOCKET_TABLE_SHARD_BITS;
+    SocketShard & rShard = m_rShards[shard];
+    
+    {
+        std::lock_guard<std::mutex> rGuard(rShard.m_lock);
+        if(handle == 0 || index >= rShard.m_size.load(std::memory_order_relaxed))
+            return false;
+        
+        SocketSlot *pSlot = GetSlot(shard, index);
+        if(pSlot->m_generation.load(std::memory_order_relaxed) != generation)
+            return false;
+        
+        if(ppParam != NULL)
+        {
+            *ppParam = pSlot->m_pParam;
+        }
+        
+        //new generation invalidates old handles, 0 is skipped
+        pSlot->m_pSocket.store(NULL, std::memory_order_release);
+        uint32 nextGeneration = generation + 1;
+        pSlot->m_generation.store(nextGeneration != 0 ? nextGeneration : 1, std::memory_order_release);
+        rShard.m_freeSlots.push_back(index);
+    }
+    
+    //last socket - wake up WaitEmpty
+    if(--m_count == 0)
+    {
+        std::lock_guard<std::mutex> rGuard(m_emptyLock);
+        m_emptyCond.notify_all();
+    }
+    return true;
+}
+
+BaseSocket * SocketTable::Get(SocketHandle handle) const
+{
+    uint32 generation = static_cast<uint32>(handle >> 32);
+    uint32 shard = static_cast<uint32>(handle) & (SOCKET_TABLE_SHARDS - 1);
+    uint32 index = static_cast<uint32>(handle) >> SOCKET_TABLE_SHARD_BITS;
+    
+    if(handle == 0 || index >= m_rShards[shard].m_size.load(std::memory_order_acquire))
+        return NULL;
+    
+    SocketSlot *pSlot = GetSlot(shard, index);
+    BaseSocket *pSocket = pSlot->m_pSocket.load(std::memory_order_acquire);
+    
+    //slot could be reused meanwhile
+    if(pSlot->m_generation.load(std::memory_order_acquire) != generation)
+        return NULL;
+    
+    return pSocket;
+}
+
+void SocketTable::GetSockets(std::list<BaseSocket*> & rSockets) const
+{
+    for(uint32 shard = 0;shard < SOCKET_TABLE_SHARDS;++shard)
+    {
+        uint32 size = m_rShards[shard].m_size.load(std::memory_order_acquire);
+        for(uint32 i = 0;i < size;++i)
+        {
+            BaseSocket *pSocket = GetSlot(shard, i)->m_pSocket.load(std::memory_order_acquire);
+            if(pSocket != NULL)
+            {
+                rSockets.push_back(pSocket);
+            }
+        }
+    }
+}
+
+void SocketTable::WaitEmpty()
+{
+    std::unique_lock<std::mutex> rGuard(m_emptyLock);
+    while(m_count != 0)
+    {
+        m_emptyCond.wait(rGuard);
+    }
+}
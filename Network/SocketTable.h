@@ -0,0 +1,137 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SOCKET_TABLE_H
+#define SOCKET_TABLE_H
+
+#define SOCKET_TABLE_SHARD_BITS     4
+#define SOCKET_TABLE_SHARDS         (1 << SOCKET_TABLE_SHARD_BITS)
+#define SOCKET_TABLE_CHUNK_SIZE     1024
+#define SOCKET_TABLE_MAX_CHUNKS     1024    //max 1M sockets per shard
+
+class BaseSocket;
+
+/** Handle of registered socket - generation (high 32 bits) and slot index with shard (low 32 bits), 0 is invalid
+ */
+typedef uint64 SocketHandle;
+
+/** Slot of socket table, slots are never freed - readers can access them without lock
+ */
+struct SocketSlot
+{
+    std::atomic<BaseSocket*>    m_pSocket;
+    std::atomic<uint32>         m_generation;
+    void                        *m_pParam;      //engine data (epoll reactor)
+};
+
+/** Sharded index-addressed socket registry. Add/Remove lock one shard and are O(1),
+ * Get/ForEach are lock-free. Removed socket can still be visited by running ForEach -
+ * engines delete sockets deferred so pointer stays valid.
+ */
+class SocketTable
+{
+public:
+    SocketTable();
+    ~SocketTable();
+    
+    /** Registers socket, returns its handle
+     */
+    SocketHandle Add(BaseSocket * pSocket, void * pParam);
+    
+    /** Unregisters socket
+     * @param ppParam receives param passed to Add
+     * @return false if handle is stale (already removed)
+     */
+    bool Remove(SocketHandle handle, void ** ppParam = NULL);
+    
+    /** Returns socket by handle, NULL if handle is stale
+     */
+    BaseSocket * Get(SocketHandle handle) const;
+    
+    /** Number of registered sockets
+     */
+    size_t GetCount() const     { return m_count; }
+    
+    /** Copies registered sockets to list
+     */
+    void GetSockets(std::list<BaseSocket*> & rSockets) const;
+    
+    /** Blocks until table is empty
+     */
+    void WaitEmpty();
+    
+    /** Calls f(BaseSocket*) for every registered socket - lock-free
+     */
+    template<class F>
+    void ForEach(F f) const
+    {
+        for(uint32 shard = 0;shard < SOCKET_TABLE_SHARDS;++shard)
+        {
+            const SocketShard & rShard = m_rShards[shard];
+            uint32 size = rShard.m_size.load(std::memory_order_acquire);
+            for(uint32 i = 0;i < size;++i)
+            {
+                SocketSlot *pChunk = rShard.m_pChunks[i / SOCKET_TABLE_CHUNK_SIZE].load(std::memory_order_acquire);
+                BaseSocket *pSocket = pChunk[i % SOCKET_TABLE_CHUNK_SIZE].m_pSocket.load(std::memory_order_acquire);
+                if(pSocket != NULL)
+                {
+                    f(pSocket);
+                }
+            }
+        }
+    }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(SocketTable);
+    
+    /** Returns slot by shard index, slot must exist
+     */
+    SocketSlot * GetSlot(uint32 shard, uint32 index) const;
+    
+    /** Shard - own lock and free list, aligned to cache line
+     */
+    struct alignas(64) SocketShard
+    {
+        SocketShard() : m_size(0)
+        {
+            for(uint32 i = 0;i < SOCKET_TABLE_MAX_CHUNKS;++i)
+            {
+                m_pChunks[i].store(NULL, std::memory_order_relaxed);
+            }
+        }
+        
+        std::mutex                  m_lock;
+        std::vector<uint32>         m_freeSlots;
+        std::atomic<uint32>         m_size;         //used slots, published after slot init
+        std::atomic<SocketSlot*>    m_pChunks[SOCKET_TABLE_MAX_CHUNKS];
+    };
+    
+    SocketShard                 m_rShards[SOCKET_TABLE_SHARDS];
+    std::atomic<uint32>         m_nextShard;
+    std::atomic<size_t>         m_count;
+    
+    /** Empty table signal for WaitEmpty
+     */
+    std::mutex                  m_emptyLock;
+    std::condition_variable     m_emptyCond;
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Network.h"
+
+TimerWheel::TimerWheel(uint32 tick, uint64 now) : m_tick(std::max<uint32>(tick, 1)), m_count(0)
+{
+    m_nextTick = now / m_tick;
+    
+    for(uint32 i = 0;i < TIMER_WHEEL_ROOT_SIZE;++i)
+    {
+        InitList(&m_rRoot[i]);
+    }
+    
+    for(uint32 level = 0;level < TIMER_WHEEL_LEVELS;++level)
+    {
+        for(uint32 i = 0;i < TIMER_WHEEL_LEVEL_SIZE;++i)
+        {
+            InitList(&m_rLevels[level][i]);
+        }
+    }
+}
+
+void TimerWheel::SpliceList(TimerLink *pFrom, TimerLink *pTo)
+{
+    if(pFrom->m_pNext == pFrom)
+        return;
+    
+    pTo->m_pNext = pFrom->m_pNext;
+    pTo->m_pPrev = pFrom->m_pPrev;
+    pTo->m_pNext->m_pPrev = pTo;
+    pTo->m_pPrev->m_pNext = pTo;
+    InitList(pFrom);
+}
+
+void TimerWheel::AppendList(TimerLink *pFrom, TimerLink *pTo)
+{
+    if(pFrom->m_pNext == pFrom)
+        return;
+    
+    pFrom->m_pNext->m_pPrev = pTo->m_pPrev;
+    pTo->m_pPrev->m_pNext = pFrom->m_pNext;
+    pFrom->m_pPrev->m_pNext = pTo;
+    pTo->m_pPrev = pFrom->m_pPrev;
+    InitList(pFrom);
+}
+
+void TimerWheel::AddNode(TimerNode *pNode)
+{
+    //already expired - fire on next processed tick
+    if(pNode->m_expire < m_nextTick)
+    {
+        pNode->m_expire = m_nextTick;
+    }
+    
+    uint64 delta = pNode->m_expire - m_nextTick;
+    if(delta > TIMER_WHEEL_MAX_TICKS)
+    {
+        delta = TIMER_WHEEL_MAX_TICKS;
+        pNode->m_expire = m_nextTick + delta;
+    }
+    
+    TimerLink *pHead;
+    if(delta < TIMER_WHEEL_ROOT_SIZE)
+    {
+        pHead = &m_rRoot[pNode->m_expire & TIMER_WHEEL_ROOT_MASK];
+    }
+    else
+    {
+        uint32 level = 0;
+        uint32 shift = TIMER_WHEEL_ROOT_BITS;
+        while(level + 1 < TIMER_WHEEL_LEVELS && delta >= (1ULL << (shift + TIMER_WHEEL_LEVEL_BITS)))
+        {
+            ++level;
+            shift += TIMER_WHEEL_LEVEL_BITS;
+        }
+        pHead = &m_rLevels[level][(pNode->m_expire >> shift) & TIMER_WHEEL_LEVEL_MASK];
+    }
+    
+    LinkTail(pHead, pNode);
+}
+
+void TimerWheel::Schedule(TimerNode *pNode, uint64 expire)
+{
+    if(pNode->IsScheduled())
+    {
+        Unlink(pNode);
+        --m_count;
+    }
+    
+    //round up - timer never fires sooner than requested
+    pNode->m_expire = (expire + m_tick - 1) / m_tick;
+    AddNode(pNode);
+    ++m_count;
+}
+
+void TimerWheel::Cancel(TimerNode *pNode)
+{
+    if(pNode->IsScheduled())
+    {
+        Unlink(pNode);
+        --m_count;
+    }
+}
+
+uint32 TimerWheel::Cascade(uint32 level)
+{
+    uint32 shift = TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS;
+    uint32 index = static_cast<uint32>((m_nextTick >> shift) & TIMER_WHEEL_LEVEL_MASK);
+    
+    TimerLink rList;
+    InitList(&rList);
+    SpliceList(&m_rLevels[level][index], &rList);
+    
+    while(rList.m_pNext != &rList)
+    {
+        TimerNode *pNode = static_cast<TimerNode*>(rList.m_pNext);
+        Unlink(pNode);
+        AddNode(pNode);
+    }
+    return index;
+}
+
+size_t TimerWheel::FireList(TimerLink *pHead)
+{
+    size_t count = 0;
+    
+    //callback can cancel other timer from this list, so unlink one by one
+    while(pHead->m_pNext != pHead)
+    {
+        TimerNode *pNode = static_cast<TimerNode*>(pHead->m_pNext);
+        Unlink(pNode);
+        --m_count;
+        ++count;
+        
+        pNode->m_pCallback(pNode);
+    }
+    return count;
+}
+
+size_t TimerWheel::Advance(uint64 now)
+{
+    uint64 targetTick = now / m_tick;
+    size_t count = 0;
+    
+    while(m_nextTick <= targetTick)
+    {
+        //nothing to process - skip idle ticks
+        if(m_count == 0)
+        {
+            m_nextTick = targetTick + 1;
+            break;
+        }
+        
+        uint32 index = static_cast<uint32>(m_nextTick & TIMER_WHEEL_ROOT_MASK);
+        if(index == 0)
+        {
+            for(uint32 level = 0;level < TIMER_WHEEL_LEVELS;++level)
+            {
+                if(Cascade(level) != 0)
+                    break;
+            }
+        }
+        
+        TimerLink rList;
+        InitList(&rList);
+        SpliceList(&m_rRoot[index], &rList);
+        
+        //timers added by callbacks go at least to next tick
+        ++m_nextTick;
+        count += FireList(&rList);
+    }
+    return count;
+}
+
+size_t TimerWheel::ExpireAll()
+{
+    //collect everything first - timer re-armed from callback is not fired again
+    TimerLink rList;
+    InitList(&rList);
+    
+    for(uint32 i = 0;i < TIMER_WHEEL_ROOT_SIZE;++i)
+    {
+        AppendList(&m_rRoot[i], &rList);
+    }
+    
+    for(uint32 level = 0;level < TIMER_WHEEL_LEVELS;++level)
+    {
+        for(uint32 i = 0;i < TIMER_WHEEL_LEVEL_SIZE;++i)
+        {
+            AppendList(&m_rLevels[level][i], &rList);
+        }
+    }
+    
+    return FireList(&rList);
+}
+
+int TimerWheel::GetTimeout(uint64 now) const
+{
+    if(m_count == 0)
+        return -1;
+    
+    //find first used slot before next cascade, otherwise wake up on cascade
+    uint64 tick = m_nextTick;
+    while((tick & TIMER_WHEEL_ROOT_MASK) != 0 && m_rRoot[tick & TIMER_WHEEL_ROOT_MASK].m_pNext == &m_rRoot[tick & TIMER_WHEEL_ROOT_MASK])
+    {
+        ++tick;
+    }
+    
+    uint64 expire = tick * m_tick;
+    if(expire <= now)
+        return 0;
+    
+    return static_cast<int>(std::min<uint64>(expire - now, INT_MAX));
+}
@@ -0,0 +1,154 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/* Wheel levels - 256 slots in first level, 64 slots in next 3 levels (range 2^26 ticks) */
+#define TIMER_WHEEL_ROOT_BITS   8
+#define TIMER_WHEEL_LEVEL_BITS  6
+#define TIMER_WHEEL_ROOT_SIZE   (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE  (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_ROOT_MASK   (TIMER_WHEEL_ROOT_SIZE - 1)
+#define TIMER_WHEEL_LEVEL_MASK  (TIMER_WHEEL_LEVEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS      3
+#define TIMER_WHEEL_MAX_TICKS   ((1ULL << (TIMER_WHEEL_ROOT_BITS + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_BITS)) - 1)
+
+struct TimerNode;
+typedef void (*TimerCallback)(TimerNode *pNode);
+
+/** Link of intrusive circular list, list head is link without timer
+ */
+struct TimerLink
+{
+    TimerLink() NOEXCEPT : m_pPrev(NULL), m_pNext(NULL)
+    {
+    }
+    
+    TimerLink   *m_pPrev;
+    TimerLink   *m_pNext;
+};
+
+/** Timer - embedded into owner object, owner must outlive it or cancel it
+ */
+struct TimerNode : public TimerLink
+{
+    TimerNode() NOEXCEPT : m_expire(0), m_pCallback(NULL), m_pParam(NULL)
+    {
+    }
+    
+    /** Is timer in wheel?
+     */
+    bool IsScheduled() const    { return m_pNext != NULL; }
+    
+    uint64          m_expire;       //in ticks
+    TimerCallback   m_pCallback;
+    void            *m_pParam;
+};
+
+/** Hierarchical timing wheel - O(1) schedule and cancel, timers are cascaded to lower level
+ * once per 256 ticks. Not thread safe - owned by one thread (reactor).
+ */
+class TimerWheel
+{
+public:
+    /** Constructor
+     * @param tick resolution in ms
+     * @param now current time in ms
+     */
+    explicit TimerWheel(uint32 tick, uint64 now);
+    
+    /** Schedules timer to absolute time in ms, already scheduled timer is moved
+     */
+    void Schedule(TimerNode *pNode, uint64 expire);
+    
+    /** Removes timer from wheel
+     */
+    void Cancel(TimerNode *pNode);
+    
+    /** Fires all timers expired up to now (ms), callbacks can schedule/cancel timers and delete their owner
+     * @return number of fired timers
+     */
+    size_t Advance(uint64 now);
+    
+    /** Fires all timers once regardless of expire time - shutdown, timers scheduled from callbacks stay in wheel
+     */
+    size_t ExpireAll();
+    
+    /** Returns ms to next expiring timer (tick precision), -1 if wheel is empty
+     */
+    int GetTimeout(uint64 now) const;
+    
+    /** Number of scheduled timers
+     */
+    size_t GetCount() const     { return m_count; }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+    
+    /** Adds timer to slot by its expire tick
+     */
+    void AddNode(TimerNode *pNode);
+    
+    /** Moves timers from level slot to lower levels, returns slot index
+     */
+    uint32 Cascade(uint32 level);
+    
+    /** Fires timers from list
+     */
+    size_t FireList(TimerLink *pHead);
+    
+    static INLINE void InitList(TimerLink *pHead)
+    {
+        pHead->m_pPrev = pHead->m_pNext = pHead;
+    }
+    
+    static INLINE void LinkTail(TimerLink *pHead, TimerLink *pLink)
+    {
+        pLink->m_pNext = pHead;
+        pLink->m_pPrev = pHead->m_pPrev;
+        pHead->m_pPrev->m_pNext = pLink;
+        pHead->m_pPrev = pLink;
+    }
+    
+    static INLINE void Unlink(TimerLink *pLink)
+    {
+        pLink->m_pPrev->m_pNext = pLink->m_pNext;
+        pLink->m_pNext->m_pPrev = pLink->m_pPrev;
+        pLink->m_pPrev = pLink->m_pNext = NULL;
+    }
+    
+    /** Moves all links from pFrom to empty list pTo
+     */
+    static void SpliceList(TimerLink *pFrom, TimerLink *pTo);
+    
+    /** Moves all links from pFrom to end of list pTo
+     */
+    static void AppendList(TimerLink *pFrom, TimerLink *pTo);
+    
+    uint32      m_tick;
+    uint64      m_nextTick;     //first not processed tick
+    size_t      m_count;
+    TimerLink   m_rRoot[TIMER_WHEEL_ROOT_SIZE];
+    TimerLink   m_rLevels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+};
+
+#endif
@@ -328,6 +328,17 @@ public:
 		return m_pBuff->size;
 	}
     
+	INLINE size_t capacity() const NOEXCEPT
+	{
+		return m_pBuff->capacity;
+	}
+    
+    //writable storage for direct fill (up to capacity), call resize after - pointer is invalidated by reserve
+	INLINE uint8 *storage() NOEXCEPT
+	{
+		return m_pBuff->storage;
+	}
+    
 	INLINE void resize(size_t newsize) NOEXCEPT
 	{
         bbuff_resize(m_pBuff, newsize);
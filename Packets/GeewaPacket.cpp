@@ -8,8 +8,22 @@
 
 #include "GeewaPacket.h"
 
-GeewaPacket::GeewaPacket() : m_allDataCounter(0), m_opcode(0), m_hasAllData(false)
+//FNV-1a of lower case string
+static uint32 GeewaPacket_hash(const char *pData, size_t length)
 {
+    uint32 hash = 2166136261U;
+    for(size_t i = 0;i < length;++i)
+    {
+        hash ^= static_cast<uint32>(tolower(static_cast<uint8>(pData[i])));
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+GeewaPacket::GeewaPacket() : m_allDataCounter(0), m_opcode(0), m_hasAllData(false), m_headerState(HEADER_STATE_NONE)
+{
+    m_headerArena.reserve(1024);
+    m_headers.reserve(16);
     ClearPacket();
 }
 
@@ -27,6 +41,100 @@ void GeewaPacket::AddHTTPData(char *pData, size_t dataSize)
     http_parser_execute(&m_rHttp_parser, &m_rHttp_parser_settings, pData, dataSize);
 }
 
+void GeewaPacket::AddHeaderField(const char *pData, size_t length)
+{
+    if(m_headerState == HEADER_STATE_VALUE)
+    {
+        FinishHeader();
+    }
+    
+    //new header, name can come in more parts
+    if(m_headerState == HEADER_STATE_NONE)
+    {
+        GeewaHeader rHeader;
+        memset(&rHeader, 0, sizeof(GeewaHeader));
+        rHeader.m_nameOffset = static_cast<uint32>(m_headerArena.size());
+        m_headers.push_back(rHeader);
+        m_headerState = HEADER_STATE_NAME;
+    }
+    
+    m_headerArena.insert(m_headerArena.end(), pData, pData + length);
+    m_headers.back().m_nameLength += static_cast<uint32>(length);
+}
+
+void GeewaPacket::AddHeaderValue(const char *pData, size_t length)
+{
+    if(m_headerState == HEADER_STATE_NONE)
+        return;
+    
+    //name is complete
+    if(m_headerState == HEADER_STATE_NAME)
+    {
+        GeewaHeader & rHeader = m_headers.back();
+        rHeader.m_hash = GeewaPacket_hash(&m_headerArena[rHeader.m_nameOffset], rHeader.m_nameLength);
+        m_headerArena.push_back(0);
+        rHeader.m_valueOffset = static_cast<uint32>(m_headerArena.size());
+        m_headerState = HEADER_STATE_VALUE;
+    }
+    
+    m_headerArena.insert(m_headerArena.end(), pData, pData + length);
+    m_headers.back().m_valueLength += static_cast<uint32>(length);
+}
+
+void GeewaPacket::FinishHeader()
+{
+    //header without value
+    if(m_headerState == HEADER_STATE_NAME)
+    {
+        AddHeaderValue(NULL, 0);
+    }
+    
+    if(m_headerState == HEADER_STATE_VALUE)
+    {
+        m_headerArena.push_back(0);
+    }
+    m_headerState = HEADER_STATE_NONE;
+}
+
+const char *GeewaPacket::GetHeader(const char *pName, size_t *pLength) const
+{
+    size_t nameLength = strlen(pName);
+    uint32 hash = GeewaPacket_hash(pName, nameLength);
+    for(GeewaHeaderVec::const_iterator itr = m_headers.begin();itr != m_headers.end();++itr)
+    {
+        if(itr->m_hash == hash && itr->m_nameLength == nameLength && strnicmp(&m_headerArena[itr->m_nameOffset], pName, nameLength) == 0)
+        {
+            if(pLength != NULL)
+            {
+                *pLength = itr->m_valueLength;
+            }
+            return &m_headerArena[itr->m_valueOffset];
+        }
+    }
+    return NULL;
+}
+
+static int GeewaPacket_on_header_field(http_parser *pParser, const char *at, size_t length)
+{
+    GeewaPacket *pGeewaPacket = static_cast<GeewaPacket*>(pParser->data);
+    pGeewaPacket->AddHeaderField(at, length);
+    return 0;
+}
+
+static int GeewaPacket_on_header_value(http_parser *pParser, const char *at, size_t length)
+{
+    GeewaPacket *pGeewaPacket = static_cast<GeewaPacket*>(pParser->data);
+    pGeewaPacket->AddHeaderValue(at, length);
+    return 0;
+}
+
+static int GeewaPacket_on_headers_complete(http_parser *pParser)
+{
+    GeewaPacket *pGeewaPacket = static_cast<GeewaPacket*>(pParser->data);
+    pGeewaPacket->FinishHeader();
+    return 0;
+}
+
 static int GeewaPacket_on_body(http_parser *pParser, const char *at, size_t length)
 {
     GeewaPacket *pGeewaPacket = static_cast<GeewaPacket*>(pParser->data);
@@ -53,6 +161,14 @@ void GeewaPacket::ClearPacket()
     memset(&m_rHttp_parser_settings, 0, sizeof(http_parser_settings));
     m_rHttp_parser_settings.on_message_complete = &GeewaPacket_on_message_complete;
     m_rHttp_parser_settings.on_body = &GeewaPacket_on_body;
+    m_rHttp_parser_settings.on_header_field = &GeewaPacket_on_header_field;
+    m_rHttp_parser_settings.on_header_value = &GeewaPacket_on_header_value;
+    m_rHttp_parser_settings.on_headers_complete = &GeewaPacket_on_headers_complete;
+    
+    //keeps capacity
+    m_headerArena.clear();
+    m_headers.clear();
+    m_headerState = HEADER_STATE_NONE;
     
     //clear variables
     m_data.clear();
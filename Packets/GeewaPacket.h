@@ -13,7 +13,17 @@
 #include "ByteBuffer.h"
 #include "http_parser.h"
 
-typedef std::map<std::string, std::string> HeaderMap;
+//header stored in packet arena
+struct GeewaHeader
+{
+    uint32  m_hash;         //hash of lower case name
+    uint32  m_nameOffset;
+    uint32  m_nameLength;
+    uint32  m_valueOffset;
+    uint32  m_valueLength;
+};
+
+typedef std::vector<GeewaHeader> GeewaHeaderVec;
 
 class GeewaPacket
 {
@@ -27,6 +37,19 @@ public:
     //clear packet for reuse
     void ClearPacket();
     
+    //returns zero terminated header value or NULL, name is case insensitive
+    const char *GetHeader(const char *pName, size_t *pLength = NULL) const;
+    
+    //captured headers
+    size_t GetHeaderCount() const                   { return m_headers.size(); }
+    const char *GetHeaderName(size_t index) const   { return &m_headerArena[m_headers[index].m_nameOffset]; }
+    const char *GetHeaderValue(size_t index) const  { return &m_headerArena[m_headers[index].m_valueOffset]; }
+    
+    //http parser callbacks
+    void AddHeaderField(const char *pData, size_t length);
+    void AddHeaderValue(const char *pData, size_t length);
+    void FinishHeader();
+    
     //public declarations
     ByteBuffer  m_data;
     size_t      m_allDataCounter;
@@ -34,9 +57,21 @@ public:
     bool        m_hasAllData;
     
 private:
+    enum HeaderState
+    {
+        HEADER_STATE_NONE   = 0,
+        HEADER_STATE_NAME   = 1,
+        HEADER_STATE_VALUE  = 2,
+    };
+    
     //http parser
     http_parser             m_rHttp_parser;
     http_parser_settings    m_rHttp_parser_settings;
+    
+    //header names and values (zero terminated) - index points to arena, both are cleared in O(1)
+    std::vector<char>       m_headerArena;
+    GeewaHeaderVec          m_headers;
+    uint8                   m_headerState;
 };
 
 #endif
@@ -0,0 +1,52 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SHAREDBYTEBUFFER_H
+#define SHAREDBYTEBUFFER_H
+
+#include "../Defines.h"
+#include "../Memory/ReferenceCounter.h"
+#include "ByteBuffer.h"
+
+/** Reference counted ByteBuffer - serialized once and queued on many sockets without copy.
+ * Created with reference count 1, every owner calls release() when done.
+ */
+class SharedByteBuffer : public ByteBuffer, public ReferenceCounter
+{
+public:
+    SharedByteBuffer() NOEXCEPT : ByteBuffer(), ReferenceCounter()
+    {
+    }
+    
+    SharedByteBuffer(size_t res) NOEXCEPT : ByteBuffer(res), ReferenceCounter()
+    {
+    }
+    
+    //take content of already serialized buffer
+    SharedByteBuffer(ByteBuffer &&buf) NOEXCEPT : ByteBuffer(std::move(buf)), ReferenceCounter()
+    {
+    }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(SharedByteBuffer);
+};
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Threading.h"
+#include "../Logs/Log.h"
+
+//worker running on current thread, submit pushes to its deque
+static thread_local TaskExecutor *t_pExecutor = NULL;
+static thread_local uint32 t_workerId = 0;
+
+class TaskExecutorWorker : public ThreadContext
+{
+public:
+    explicit TaskExecutorWorker(TaskExecutor & rExecutor, uint32 workerId) : m_rExecutor(rExecutor), m_workerId(workerId)
+    {
+    }
+    
+    bool run()
+    {
+        CommonFunctions::SetThreadName("TaskExecutor worker %u", m_workerId);
+        m_rExecutor.WorkerLoop(m_workerId);
+        return true;
+    }
+    
+    void OnShutdown()
+    {
+        m_rExecutor.Stop();
+    }
+    
+private:
+    TaskExecutor    &m_rExecutor;
+    uint32          m_workerId;
+};
+
+TaskExecutor::TaskExecutor() : m_submitLock(false), m_pending(0), m_running(false), m_sleepers(0), m_runningWorkers(0)
+{
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    Shutdown();
+}
+
+void TaskExecutor::Startup(uint32 workerCount)
+{
+    if(workerCount == 0)
+    {
+        workerCount = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    
+    m_running = true;
+    m_runningWorkers = workerCount;
+    for(uint32 i = 0;i < workerCount;++i)
+    {
+        m_workers.push_back(new Worker(i * 2654435761U + 1));
+    }
+    
+    for(uint32 i = 0;i < workerCount;++i)
+    {
+        ThreadPool.ExecuteTask(new TaskExecutorWorker(*this, i));
+    }
+    
+    Log.Debug(__FUNCTION__, "Started %u workers.", workerCount);
+}
+
+void TaskExecutor::Stop()
+{
+    std::lock_guard<std::mutex> rGuard(m_sleepLock);
+    m_running = false;
+    m_sleepCond.notify_all();
+}
+
+void TaskExecutor::Shutdown()
+{
+    if(m_workers.empty())
+        return;
+    
+    Stop();
+    
+    {
+        std::unique_lock<std::mutex> rGuard(m_sleepLock);
+        while(m_runningWorkers != 0)
+        {
+            m_exitCond.wait(rGuard);
+        }
+    }
+    
+    for(size_t i = 0;i < m_workers.size();++i)
+    {
+        delete m_workers[i];
+    }
+    m_workers.clear();
+}
+
+bool TaskExecutor::Submit(CallbackBase * pTask, TaskPriority priority)
+{
+    //count first - worker can take task before push returns
+    m_pending.fetch_add(1, std::memory_order_seq_cst);
+    
+    //no worker would take it - pairs with m_running check before exit in WorkerLoop,
+    //task running during Shutdown still queues to its own worker which executes it before exit
+    if(t_pExecutor != this && !m_running.load(std::memory_order_seq_cst))
+    {
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+        Log.Warning(__FUNCTION__, "Executor is not running, task was dropped.");
+        delete pTask;
+        return false;
+    }
+    
+    if(t_pExecutor == this)
+    {
+        m_workers[t_workerId]->m_rDeques[priority].push(pTask);
+    }
+    else
+    {
+        m_rSubmitted[priority].push(new TaskNode(pTask));
+    }
+    
+    //pairs with m_sleepers increment before m_pending check in WorkerLoop
+    if(m_sleepers.load(std::memory_order_seq_cst) != 0)
+    {
+        std::lock_guard<std::mutex> rGuard(m_sleepLock);
+        m_sleepCond.notify_one();
+    }
+    return true;
+}
+
+CallbackBase * TaskExecutor::TakeSubmitted(Worker & rWorker, uint32 priority)
+{
+    //other worker is draining queue
+    if(m_submitLock.exchange(true, std::memory_order_acquire))
+        return NULL;
+    
+    CallbackBase *pResult = NULL;
+    TaskNode *pNode;
+    for(uint32 i = 0;i < TASK_EXECUTOR_INJECT_BATCH && (pNode = m_rSubmitted[priority].pop()) != NULL;++i)
+    {
+        if(pResult == NULL)
+        {
+            pResult = pNode->m_pTask;
+        }
+        else
+        {
+            rWorker.m_rDeques[priority].push(pNode->m_pTask);
+        }
+        delete pNode;
+    }
+    
+    m_submitLock.store(false, std::memory_order_release);
+    return pResult;
+}
+
+CallbackBase * TaskExecutor::FindTask(Worker & rWorker, uint32 workerId)
+{
+    CallbackBase *pTask;
+    uint32 workerCount = static_cast<uint32>(m_workers.size());
+    
+    for(uint32 priority = 0;priority < NUM_TASK_PRIORITIES;++priority)
+    {
+        if((pTask = rWorker.m_rDeques[priority].pop()) != NULL)
+            return pTask;
+        
+        if((pTask = TakeSubmitted(rWorker, priority)) != NULL)
+            return pTask;
+        
+        //steal - start from random victim (xorshift)
+        rWorker.m_seed ^= rWorker.m_seed << 13;
+        rWorker.m_seed ^= rWorker.m_seed >> 17;
+        rWorker.m_seed ^= rWorker.m_seed << 5;
+        uint32 start = rWorker.m_seed % workerCount;
+        for(uint32 i = 0;i < workerCount;++i)
+        {
+            uint32 victim = (start + i) % workerCount;
+            if(victim != workerId && (pTask = m_workers[victim]->m_rDeques[priority].steal()) != NULL)
+                return pTask;
+        }
+    }
+    return NULL;
+}
+
+void TaskExecutor::WorkerLoop(uint32 workerId)
+{
+    Worker &rWorker = *m_workers[workerId];
+    t_pExecutor = this;
+    t_workerId = workerId;
+    
+    for(;;)
+    {
+        CallbackBase *pTask = FindTask(rWorker, workerId);
+        if(pTask != NULL)
+        {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            pTask->execute();
+            delete pTask;
+            continue;
+        }
+        
+        //pending task can be in the middle of push - retry
+        if(m_pending.load(std::memory_order_seq_cst) != 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> rGuard(m_sleepLock);
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        while(m_pending.load(std::memory_order_seq_cst) == 0 && m_running)
+        {
+            m_sleepCond.wait(rGuard);
+        }
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        
+        //remaining tasks are executed before exit
+        if(!m_running && m_pending == 0)
+            break;
+    }
+    
+    t_pExecutor = NULL;
+    
+    //executor can be destroyed after unlock
+    std::lock_guard<std::mutex> rGuard(m_sleepLock);
+    --m_runningWorkers;
+    m_exitCond.notify_all();
+}
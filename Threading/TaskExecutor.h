@@ -0,0 +1,138 @@
+/*
+ * Game server
+ * Copyright (C) 2010 Miroslav 'Wayland' Kudrnac
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef TASK_EXECUTOR_H
+#define TASK_EXECUTOR_H
+
+#include "../CallBack.h"
+#include "../Containers/MPSCQueue.h"
+#include "../Containers/WorkStealingDeque.h"
+
+#define TASK_EXECUTOR_INJECT_BATCH  32      //tasks moved from submit queue to worker deque at once
+
+enum TaskPriority
+{
+    TASK_PRIORITY_HIGH      = 0,
+    TASK_PRIORITY_NORMAL    = 1,
+    TASK_PRIORITY_LOW       = 2,
+    NUM_TASK_PRIORITIES     = 3,
+};
+
+/** Task submitted from thread outside of executor
+ */
+struct TaskNode : public MPSCNode
+{
+    explicit TaskNode(CallbackBase *pTask) : m_pTask(pTask)
+    {
+    }
+    
+    CallbackBase    *m_pTask;
+};
+
+/** Fixed-size work-stealing executor for short tasks, workers run on ThreadPool.
+ * Each worker owns Chase-Lev deque per priority, idle workers steal from others.
+ * Submit from worker thread pushes to its own deque, submit from other threads is lock-free push to shared queue.
+ * Higher priority is always searched first. Executor owns submitted tasks and deletes them after execute().
+ */
+class TaskExecutor
+{
+    friend class TaskExecutorWorker;
+    
+public:
+    explicit TaskExecutor();
+    ~TaskExecutor();
+    
+    /** Starts workers
+     * @param workerCount 0 = number of CPU cores
+     */
+    void Startup(uint32 workerCount = 0);
+    
+    /** Executes remaining tasks and waits for workers to exit
+     */
+    void Shutdown();
+    
+    /** Queues task - can be called from any thread, including tasks
+     * @return false if executor is not running (before Startup, after Shutdown started) - task is deleted without execution
+     */
+    bool Submit(CallbackBase * pTask, TaskPriority priority = TASK_PRIORITY_NORMAL);
+    
+    /** Queued tasks not yet started
+     */
+    size_t GetPendingCount() const      { return m_pending; }
+    
+    /** Number of workers
+     */
+    uint32 GetWorkerCount() const       { return static_cast<uint32>(m_workers.size()); }
+    
+private:
+    //disable copy constructor and assign
+    DISALLOW_COPY_AND_ASSIGN(TaskExecutor);
+    
+    /** Worker data, allocated separately
+     */
+    struct Worker
+    {
+        explicit Worker(uint32 seed) : m_seed(seed)
+        {
+        }
+        
+        WorkStealingDeque<CallbackBase> m_rDeques[NUM_TASK_PRIORITIES];
+        uint32                          m_seed;     //victim selection, owner thread only
+    };
+    
+    /** Worker thread loop
+     */
+    void WorkerLoop(uint32 workerId);
+    
+    /** Own deque, then submit queue, then steal - for each priority
+     */
+    CallbackBase * FindTask(Worker & rWorker, uint32 workerId);
+    
+    /** Moves batch of submitted tasks to worker deque, returns one of them
+     */
+    CallbackBase * TakeSubmitted(Worker & rWorker, uint32 priority);
+    
+    /** Signals workers to exit when there is no work
+     */
+    void Stop();
+    
+    std::vector<Worker*>        m_workers;
+    
+    /** Tasks submitted from other threads - single consumer guarded by m_submitLock
+     */
+    MPSCQueue<TaskNode>         m_rSubmitted[NUM_TASK_PRIORITIES];
+    std::atomic<bool>           m_submitLock;
+    
+    std::atomic<size_t>         m_pending;
+    std::atomic<bool>           m_running;
+    
+    /** Idle workers sleep here, submit signals only when m_sleepers != 0
+     */
+    std::atomic<uint32>         m_sleepers;
+    std::mutex                  m_sleepLock;
+    std::condition_variable     m_sleepCond;
+    
+    /** Running workers for Shutdown
+     */
+    uint32                      m_runningWorkers;
+    std::condition_variable     m_exitCond;
+};
+
+#endif
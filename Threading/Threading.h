@@ -32,5 +32,8 @@
 // Thread Pool
 #include "ThreadPool.h"
 
+// Work-stealing executor for short tasks
+#include "TaskExecutor.h"
+
 #endif
 
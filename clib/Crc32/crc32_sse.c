@@ -9,8 +9,20 @@
 #include "../Log/CLog.h"
 #include "crc32_sse.h"
 
+#if defined(_M_X64) || defined(__x86_64__)
+    #define CRC32_X64 1
+#endif
+
 #ifdef WIN32
     #include <nmmintrin.h>
+    #include <wmmintrin.h>
+
+    #ifdef CRC32_X64
+    static inline uint64_t crc32_clmul(uint32_t a, uint32_t b)
+    {
+        return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_cvtsi32_si128((int)a), _mm_cvtsi32_si128((int)b), 0));
+    }
+    #endif
 #else
     static inline uint32_t _mm_crc32_u32(uint32_t crc, uint32_t value)
     {
@@ -23,6 +35,28 @@
         __asm__("crc32b %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
         return crc;
     }
+
+    #ifdef CRC32_X64
+    static inline uint64_t _mm_crc32_u64(uint64_t crc, uint64_t value)
+    {
+        __asm__("crc32q %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
+        return crc;
+    }
+
+    //carry-less multiply of two 32-bit values
+    static inline uint64_t crc32_clmul(uint32_t a, uint32_t b)
+    {
+        uint64_t result;
+        __asm__("movq %[a], %%xmm0\n"
+                "movq %[b], %%xmm1\n"
+                "pclmulqdq $0x00, %%xmm1, %%xmm0\n"
+                "movq %%xmm0, %[result]\n"
+                : [result] "=r" (result)
+                : [a] "r" ((uint64_t)a), [b] "r" ((uint64_t)b)
+                : "xmm0", "xmm1");
+        return result;
+    }
+    #endif
 #endif
 
 // reversed 0x1EDC6F41
@@ -121,6 +155,91 @@ UINT crc32_hardware_unrolled(const BYTE * buf, SIZE_T len)
     return ~crc;
 }
 
+#ifdef CRC32_X64
+// Three independent crc32q streams hide latency of crc32 instruction (3 cycles, throughput 1),
+// streams are merged by shifting their crc over following data with PCLMULQDQ.
+#define CRC32_LONG      4096
+#define CRC32_SHORT     256
+
+//x^(8*n-33) mod P for n = 2*LONG, LONG, 2*SHORT, SHORT
+UINT m_crc_shift_long[2];
+UINT m_crc_shift_short[2];
+
+static uint32 crc32_xpow(uint32 n)
+{
+    //x^0 in reflected form, then multiply by x n times
+    uint32 p = 0x80000000;
+    for(; n; n--)
+        p = (p >> 1) ^ (CRCPOLY & (-(int)(p & 1)));
+    return p;
+}
+
+void crc32_shift_init(void)
+{
+    m_crc_shift_long[0] = crc32_xpow(8 * 2 * CRC32_LONG - 33);
+    m_crc_shift_long[1] = crc32_xpow(8 * CRC32_LONG - 33);
+    m_crc_shift_short[0] = crc32_xpow(8 * 2 * CRC32_SHORT - 33);
+    m_crc_shift_short[1] = crc32_xpow(8 * CRC32_SHORT - 33);
+}
+
+//crc0 * x^(16*size) + crc1 * x^(8*size) + crc2
+static inline uint64_t crc32_merge(uint64_t crc0, uint64_t crc1, uint64_t crc2, const UINT *shift)
+{
+    return _mm_crc32_u64(0, crc32_clmul((uint32_t)crc0, shift[0]) ^ crc32_clmul((uint32_t)crc1, shift[1])) ^ crc2;
+}
+
+UINT crc32_hardware_interleaved(const BYTE * buf, SIZE_T len)
+{
+    uint64_t crc0 = CRCINIT;
+    uint64_t crc1, crc2;
+    const BYTE *end;
+    
+    // Align to QWORD boundary
+    SIZE_T align = (sizeof(uint64_t) - (INT_PTR)buf) & (sizeof(uint64_t) - 1);
+    align = Min(align, len);
+    len -= align;
+    for (; align; align--)
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *buf++);
+    
+    while (len >= CRC32_LONG * 3) {
+        crc1 = crc2 = 0;
+        end = buf + CRC32_LONG;
+        do {
+            crc0 = _mm_crc32_u64(crc0, *(const uint64_t*)buf);
+            crc1 = _mm_crc32_u64(crc1, *(const uint64_t*)(buf + CRC32_LONG));
+            crc2 = _mm_crc32_u64(crc2, *(const uint64_t*)(buf + CRC32_LONG * 2));
+            buf += sizeof(uint64_t);
+        } while (buf < end);
+        crc0 = crc32_merge(crc0, crc1, crc2, m_crc_shift_long);
+        buf += CRC32_LONG * 2;
+        len -= CRC32_LONG * 3;
+    }
+    
+    while (len >= CRC32_SHORT * 3) {
+        crc1 = crc2 = 0;
+        end = buf + CRC32_SHORT;
+        do {
+            crc0 = _mm_crc32_u64(crc0, *(const uint64_t*)buf);
+            crc1 = _mm_crc32_u64(crc1, *(const uint64_t*)(buf + CRC32_SHORT));
+            crc2 = _mm_crc32_u64(crc2, *(const uint64_t*)(buf + CRC32_SHORT * 2));
+            buf += sizeof(uint64_t);
+        } while (buf < end);
+        crc0 = crc32_merge(crc0, crc1, crc2, m_crc_shift_short);
+        buf += CRC32_SHORT * 2;
+        len -= CRC32_SHORT * 3;
+    }
+    
+    end = buf + (len - (len & (sizeof(uint64_t) - 1)));
+    for (; buf < end; buf += sizeof(uint64_t))
+        crc0 = _mm_crc32_u64(crc0, *(const uint64_t*)buf);
+    
+    len &= sizeof(uint64_t) - 1;
+    for (; len; len--)
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *buf++);
+    return ~(UINT)crc0;
+}
+#endif
+
 //will be set from crc32_init()
 crc32_func_t m_crc32_func;
 
@@ -134,6 +253,15 @@ void crc32_init(void)
     cpuid(CPUInfo, CPUID_FEATURES);
     
     //init function handler
+#ifdef CRC32_X64
+    if((CPUInfo[2] & SSE42_FEATURE_BIT) && (CPUInfo[2] & PCLMULQDQ_FEATURE_BIT))
+    {
+        Log_Notice(__FUNCTION__, "SSE42 and PCLMULQDQ supported. Using interleaved Crc32 with HW support.");
+        crc32_shift_init();
+        m_crc32_func = crc32_hardware_interleaved;
+    }
+    else
+#endif
     if(CPUInfo[2] & SSE42_FEATURE_BIT)
     {
         Log_Notice(__FUNCTION__, "SSE42 supported. Using Crc32 with HW support.");
@@ -80,12 +80,24 @@
  */
 
 /* Base64 encoder/decoder. Originally Apache file ap_base64.c
+ * SSSE3/AVX2 kernels process whole blocks of valid input, scalar code handles the rest.
  */
 
 #include <string.h>
 
 #include "base64.h"
 
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+    #define BASE64_SIMD 1
+    #include "../cpuid.h"
+    #include <immintrin.h>
+    #ifdef WIN32
+        #define BASE64_TARGET(x)
+    #else
+        #define BASE64_TARGET(x) __attribute__((target(x)))
+    #endif
+#endif
+
 /* aaaack but it's fast and const should make it shared text page. */
 static const unsigned char pr2six[256] =
 {
@@ -108,35 +120,207 @@ static const unsigned char pr2six[256] =
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64
 };
 
-int Base64decode_len(const char *bufcoded)
+static const char basis_64[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* block kernels - return count of consumed input bytes (multiple of 3 for encode, 4 for decode),
+ * decode stops before block with character outside of alphabet */
+typedef size_t (*base64_kernel_t)(unsigned char *dst, const unsigned char *src, size_t len);
+
+static size_t base64_encode_none(unsigned char *dst, const unsigned char *src, size_t len)
 {
-    int nbytesdecoded;
-    register const unsigned char *bufin;
-    register int nprbytes;
+    (void)dst;
+    (void)src;
+    (void)len;
+    return 0;
+}
+
+static size_t base64_decode_none(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    (void)dst;
+    (void)src;
+    (void)len;
+    return 0;
+}
+
+#ifdef BASE64_SIMD
+/* six bit indices -> alphabet */
+BASE64_TARGET("ssse3")
+static __m128i base64_enc_translate_ssse3(__m128i idx)
+{
+    /* 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12 */
+    __m128i sel = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    sel = _mm_or_si128(sel, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                             '/' - 63, 'A', 0, 0), sel));
+}
+
+BASE64_TARGET("ssse3")
+static size_t base64_encode_ssse3(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    __m128i in;
     
-    bufin = (const unsigned char *) bufcoded;
-    while (pr2six[*(bufin++)] <= 63);
+    /* 16 byte load, 12 bytes used, split to 16 six bit indices with multiply-shift */
+    for (; i + 16 <= len; i += 12) {
+        in = _mm_loadu_si128((const __m128i*)(src + i));
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        in = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)),
+                          _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+        _mm_storeu_si128((__m128i*)dst, base64_enc_translate_ssse3(in));
+        dst += 16;
+    }
+    return i;
+}
+
+BASE64_TARGET("ssse3")
+static int base64_dec_translate_ssse3(__m128i *pIn)
+{
+    /* range checks on signed bytes, bytes >= 0x80 match nothing */
+    __m128i in = *pIn;
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+    __m128i plus = _mm_cmpeq_epi8(in, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    __m128i shift;
     
-    nprbytes = (int)(bufin - (const unsigned char *) bufcoded) - 1;
-    nbytesdecoded = ((nprbytes + 3) / 4) * 3;
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+        return 0;
     
-    return nbytesdecoded + 1;
+    shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                         _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                      _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')), _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+    in = _mm_add_epi8(in, shift);
+    
+    /* 4 x 6 bits -> 3 bytes, packed to low 12 bytes */
+    in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+    in = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+    *pIn = _mm_shuffle_epi8(in, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    return 1;
 }
 
-int Base64decode(char *bufplain, const char *bufcoded)
+/* exact 12 byte store, output buffer is sized for valid data only */
+BASE64_TARGET("ssse3")
+static void base64_store12_ssse3(unsigned char *dst, __m128i out)
+{
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+    _mm_storel_epi64((__m128i*)dst, out);
+    memcpy(dst + 8, &last, 4);
+}
+
+BASE64_TARGET("ssse3")
+static size_t base64_decode_ssse3(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    __m128i in;
+    
+    for (; i + 16 <= len; i += 16) {
+        in = _mm_loadu_si128((const __m128i*)(src + i));
+        if (!base64_dec_translate_ssse3(&in))
+            break;
+        base64_store12_ssse3(dst, in);
+        dst += 12;
+    }
+    return i;
+}
+
+BASE64_TARGET("avx2")
+static size_t base64_encode_avx2(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    __m256i in, sel;
+    
+    /* two 16 byte loads, 12 bytes used in each lane */
+    for (; i + 28 <= len; i += 24) {
+        in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + i))),
+                                     _mm_loadu_si128((const __m128i*)(src + i + 12)), 1);
+        in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                     10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        in = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040)),
+                             _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010)));
+        
+        sel = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+        sel = _mm256_or_si256(sel, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), in), _mm256_set1_epi8(13)));
+        in = _mm256_add_epi8(in, _mm256_shuffle_epi8(_mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                                      '/' - 63, 'A', 0, 0,
+                                                                      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                                      '/' - 63, 'A', 0, 0), sel));
+        _mm256_storeu_si256((__m256i*)dst, in);
+        dst += 32;
+    }
+    return i;
+}
+
+BASE64_TARGET("avx2")
+static size_t base64_decode_avx2(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    __m256i in, upper, lower, digit, plus, slash, shift;
+    
+    for (; i + 32 <= len; i += 32) {
+        in = _mm256_loadu_si256((const __m256i*)(src + i));
+        upper = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+        lower = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+        digit = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+        plus = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('+'));
+        slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+        if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)))) != -1)
+            break;
+        
+        shift = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+                                _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                                                _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')), _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+        in = _mm256_add_epi8(in, shift);
+        in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+        in = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+        in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        base64_store12_ssse3(dst, _mm256_castsi256_si128(in));
+        base64_store12_ssse3(dst + 12, _mm256_extracti128_si256(in, 1));
+        dst += 24;
+    }
+    return i;
+}
+#endif
+
+/* will be set from Base64init() */
+static base64_kernel_t m_base64_encode = base64_encode_none;
+static base64_kernel_t m_base64_decode = base64_decode_none;
+
+void Base64init(void)
+{
+#ifdef BASE64_SIMD
+    int CPUInfo[4];
+    cpuid(CPUInfo, CPUID_FEATURES);
+    
+    if (cpuid_has_avx2()) {
+        m_base64_encode = base64_encode_avx2;
+        m_base64_decode = base64_decode_avx2;
+    } else if (CPUInfo[2] & SSSE3_FEATURE_BIT) {
+        m_base64_encode = base64_encode_ssse3;
+        m_base64_decode = base64_decode_ssse3;
+    }
+#endif
+}
+
+/* scalar decode of NUL-terminated rest, stops at first character outside of alphabet */
+static int base64_decode_scalar(unsigned char *bufout, const unsigned char *bufcoded)
 {
     int nbytesdecoded;
     register const unsigned char *bufin;
-    register unsigned char *bufout;
     register int nprbytes;
     
-    bufin = (const unsigned char *) bufcoded;
+    bufin = bufcoded;
     while (pr2six[*(bufin++)] <= 63);
-    nprbytes = (int)(bufin - (const unsigned char *) bufcoded) - 1;
+    nprbytes = (int)(bufin - bufcoded) - 1;
     nbytesdecoded = ((nprbytes + 3) / 4) * 3;
     
-    bufout = (unsigned char *) bufplain;
-    bufin = (const unsigned char *) bufcoded;
+    bufin = bufcoded;
     
     while (nprbytes > 4) {
         *(bufout++) =
@@ -168,8 +352,80 @@ int Base64decode(char *bufplain, const char *bufcoded)
     return nbytesdecoded;
 }
 
-static const char basis_64[] =
-"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+int Base64decode_len(const char *bufcoded)
+{
+    int nbytesdecoded;
+    register const unsigned char *bufin;
+    register int nprbytes;
+    
+    bufin = (const unsigned char *) bufcoded;
+    while (pr2six[*(bufin++)] <= 63);
+    
+    nprbytes = (int)(bufin - (const unsigned char *) bufcoded) - 1;
+    nbytesdecoded = ((nprbytes + 3) / 4) * 3;
+    
+    return nbytesdecoded + 1;
+}
+
+int Base64decode(char *bufplain, const char *bufcoded)
+{
+    const unsigned char *bufin = (const unsigned char *) bufcoded;
+    unsigned char *bufout = (unsigned char *) bufplain;
+    
+    /* kernels consume only whole valid blocks, output ends where scalar decode stops */
+    size_t consumed = m_base64_decode(bufout, bufin, strlen(bufcoded));
+    return (int)(consumed / 4 * 3) + base64_decode_scalar(bufout + consumed / 4 * 3, bufin + consumed);
+}
+
+int Base64decode_maxlen(int len)
+{
+    return ((len + 3) / 4 * 3) + 1;
+}
+
+int Base64decode_n(char *bufplain, const char *bufcoded, int len)
+{
+    const unsigned char *bufin = (const unsigned char *) bufcoded;
+    unsigned char *bufout = (unsigned char *) bufplain;
+    unsigned int quad = 0;
+    size_t i, n, consumed;
+    
+    /* padding is optional */
+    n = len > 0 ? (size_t)len : 0;
+    if (n && bufin[n - 1] == '=') {
+        --n;
+        if (n && bufin[n - 1] == '=')
+            --n;
+    }
+    if ((n & 3) == 1 || (len & 3 && n != (size_t)len))
+        return -1;
+    
+    consumed = m_base64_decode(bufout, bufin, n);
+    bufout += consumed / 4 * 3;
+    
+    for (i = consumed; i < n; i++) {
+        unsigned char value = pr2six[bufin[i]];
+        if (value > 63)
+            return -1;
+        
+        quad = (quad << 6) | value;
+        if ((i & 3) == 3) {
+            *(bufout++) = (unsigned char) (quad >> 16);
+            *(bufout++) = (unsigned char) (quad >> 8);
+            *(bufout++) = (unsigned char) quad;
+        }
+    }
+    
+    /* 2 or 3 characters left */
+    if ((n & 3) == 2) {
+        *(bufout++) = (unsigned char) (quad >> 4);
+    } else if ((n & 3) == 3) {
+        *(bufout++) = (unsigned char) (quad >> 10);
+        *(bufout++) = (unsigned char) (quad >> 2);
+    }
+    
+    *bufout = '\0';
+    return (int)(bufout - (unsigned char *) bufplain);
+}
 
 int Base64encode_len(int len)
 {
@@ -181,8 +437,9 @@ int Base64encode(char *encoded, const char *string, int len)
     int i;
     char *p;
     
-    p = encoded;
-    for (i = 0; i < len - 2; i += 3) {
+    i = len > 0 ? (int)m_base64_encode((unsigned char *) encoded, (const unsigned char *) string, (size_t)len) : 0;
+    p = encoded + i / 3 * 4;
+    for (; i < len - 2; i += 3) {
         *p++ = basis_64[(string[i] >> 2) & 0x3F];
         *p++ = basis_64[((string[i] & 0x3) << 4) |
                         ((int) (string[i + 1] & 0xF0) >> 4)];
@@ -88,12 +88,19 @@
 extern "C" {
 #endif
     
+    /* selects SSSE3/AVX2 kernels when CPU supports them, scalar code is used until called */
+    void Base64init(void);
+    
     int Base64encode_len(int len);
     int Base64encode(char * coded_dst, const char *plain_src,int len_plain_src);
     
     int Base64decode_len(const char * coded_src);
     int Base64decode(char * plain_dst, const char *coded_src);
     
+    /* bounded input, no NUL needed - output size without scanning, decode returns -1 on invalid input */
+    int Base64decode_maxlen(int len_coded_src);
+    int Base64decode_n(char * plain_dst, const char *coded_src, int len_coded_src);
+    
 #ifdef __cplusplus
 }
 #endif
@@ -14,12 +14,22 @@ extern "C" {
 
 #include "../Defines.h"
 
+/* PCLMULQDQ flag */
+#define PCLMULQDQ_FEATURE_BIT   (1 << 1)
+/* SSSE3 flag */
+#define SSSE3_FEATURE_BIT       (1 << 9)
 /* SSE42 flag */
 #define SSE42_FEATURE_BIT   (1 << 20)
+/* OSXSAVE flag - OS saves AVX registers */
+#define OSXSAVE_FEATURE_BIT     (1 << 27)
 /* AVX flag */
 #define AVX_FEATURE_BIT     (1 << 28)
+/* AVX2 flag (extended features, EBX) */
+#define AVX2_FEATURE_BIT        (1 << 5)
 /* CPU features */
 #define CPUID_FEATURES      1
+/* CPU extended features */
+#define CPUID_EXTENDED_FEATURES 7
 
 /* CPUID function */
 #ifdef WIN32
@@ -44,6 +54,45 @@ extern "C" {
     }
 #endif
 
+/* CPUID function with subleaf (ECX) */
+#ifdef WIN32
+    static void cpuidex(int *CPUInfo, int InfoType, int SubType)
+    {
+        __cpuidex(CPUInfo, InfoType, SubType);
+    }
+#else
+    static inline void cpuidex(int *CPUInfo, unsigned int number, unsigned int subnumber)
+    {
+        __asm__("cpuid"
+            : "=a" (CPUInfo[0]), "=b" (CPUInfo[1]), "=c" (CPUInfo[2]), "=d" (CPUInfo[3])
+            : "a" (number), "c" (subnumber)
+            );
+    }
+#endif
+
+/* returns 1 when CPU supports AVX2 and OS saves YMM registers */
+static inline int cpuid_has_avx2(void)
+{
+    int CPUInfo[4];
+    unsigned int xcr0;
+    
+    cpuid(CPUInfo, CPUID_FEATURES);
+    if(!(CPUInfo[2] & OSXSAVE_FEATURE_BIT) || !(CPUInfo[2] & AVX_FEATURE_BIT))
+        return 0;
+    
+    /* XCR0 - XMM and YMM state enabled */
+#ifdef WIN32
+    xcr0 = (unsigned int)_xgetbv(0);
+#else
+    __asm__(".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0) : "c" (0) : "edx");
+#endif
+    if((xcr0 & 6) != 6)
+        return 0;
+    
+    cpuidex(CPUInfo, CPUID_EXTENDED_FEATURES, 0);
+    return (CPUInfo[1] & AVX2_FEATURE_BIT) != 0;
+}
+
 #ifdef __cplusplus
 }
 #endif